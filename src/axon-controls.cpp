@@ -0,0 +1,303 @@
+#include "axon-controls.h"
+
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+void axon_controls_init(struct axon_controls* c)
+{
+    memset(c, 0, sizeof(*c));
+    pthread_mutex_init(&c->lock, NULL);
+}
+
+void axon_controls_free(struct axon_controls* c)
+{
+    pthread_mutex_destroy(&c->lock);
+}
+
+void axon_controls_clear(struct axon_controls* c)
+{
+    pthread_mutex_lock(&c->lock);
+    c->count = 0;
+    c->dirty = false;
+    pthread_mutex_unlock(&c->lock);
+}
+
+static bool supported_type(uint32_t type)
+{
+    return type == V4L2_CTRL_TYPE_INTEGER || type == V4L2_CTRL_TYPE_BOOLEAN ||
+           type == V4L2_CTRL_TYPE_MENU || type == V4L2_CTRL_TYPE_INTEGER_MENU;
+}
+
+static void query_menu(int fd, struct axon_control* ctrl)
+{
+    struct v4l2_querymenu qm;
+    for (int64_t i = ctrl->minimum; i <= ctrl->maximum && ctrl->num_items < AXON_MAX_MENU_ITEMS;
+         i++) {
+        memset(&qm, 0, sizeof(qm));
+        qm.id    = ctrl->id;
+        qm.index = (uint32_t) i;
+        if (ioctl(fd, VIDIOC_QUERYMENU, &qm) < 0)
+            continue; /* menus may have holes */
+
+        int n               = ctrl->num_items++;
+        ctrl->item_index[n] = qm.index;
+        if (ctrl->type == V4L2_CTRL_TYPE_MENU)
+            snprintf(ctrl->item_name[n], sizeof(ctrl->item_name[n]), "%s", (char*) qm.name);
+        else
+            snprintf(ctrl->item_name[n], sizeof(ctrl->item_name[n]), "%lld",
+                     (long long) qm.value);
+    }
+}
+
+/* one G_EXT_CTRLS for every cached control */
+static void read_values(struct axon_controls* c, int fd)
+{
+    struct v4l2_ext_control vals[AXON_MAX_CONTROLS];
+    memset(vals, 0, sizeof(vals));
+    for (int i = 0; i < c->count; i++)
+        vals[i].id = c->controls[i].id;
+
+    struct v4l2_ext_controls ext;
+    memset(&ext, 0, sizeof(ext));
+    ext.which    = V4L2_CTRL_WHICH_CUR_VAL;
+    ext.count    = (uint32_t) c->count;
+    ext.controls = vals;
+    if (ioctl(fd, VIDIOC_G_EXT_CTRLS, &ext) < 0) {
+        /* write-only or volatile controls can fail the batch; keep the defaults */
+        for (int i = 0; i < c->count; i++)
+            c->controls[i].value = c->controls[i].default_value;
+        return;
+    }
+    for (int i = 0; i < c->count; i++)
+        c->controls[i].value = vals[i].value;
+}
+
+int axon_controls_enumerate(struct axon_controls* c, int fd)
+{
+    pthread_mutex_lock(&c->lock);
+    c->count = 0;
+    c->dirty = false;
+
+    struct v4l2_query_ext_ctrl q;
+    memset(&q, 0, sizeof(q));
+    q.id = V4L2_CTRL_FLAG_NEXT_CTRL;
+    while (c->count < AXON_MAX_CONTROLS && ioctl(fd, VIDIOC_QUERY_EXT_CTRL, &q) == 0) {
+        uint32_t id = q.id;
+        if (supported_type(q.type) &&
+            !(q.flags & (V4L2_CTRL_FLAG_DISABLED | V4L2_CTRL_FLAG_READ_ONLY))) {
+            struct axon_control* ctrl = &c->controls[c->count++];
+            memset(ctrl, 0, sizeof(*ctrl));
+            ctrl->id            = q.id;
+            ctrl->type          = q.type;
+            ctrl->minimum       = q.minimum;
+            ctrl->maximum       = q.maximum;
+            ctrl->step          = q.step ? (int64_t) q.step : 1;
+            ctrl->default_value = q.default_value;
+            snprintf(ctrl->name, sizeof(ctrl->name), "%s", q.name);
+            if (q.type == V4L2_CTRL_TYPE_MENU || q.type == V4L2_CTRL_TYPE_INTEGER_MENU)
+                query_menu(fd, ctrl);
+        }
+        memset(&q, 0, sizeof(q));
+        q.id = id | V4L2_CTRL_FLAG_NEXT_CTRL;
+    }
+
+    if (c->count > 0)
+        read_values(c, fd);
+    int count = c->count;
+    pthread_mutex_unlock(&c->lock);
+    return count;
+}
+
+static struct axon_control* find_control(struct axon_controls* c, uint32_t id)
+{
+    for (int i = 0; i < c->count; i++) {
+        if (c->controls[i].id == id)
+            return &c->controls[i];
+    }
+    return NULL;
+}
+
+bool axon_controls_set(struct axon_controls* c, uint32_t id, int64_t value)
+{
+    bool changed = false;
+
+    pthread_mutex_lock(&c->lock);
+    struct axon_control* ctrl = find_control(c, id);
+    if (ctrl) {
+        if (value < ctrl->minimum)
+            value = ctrl->minimum;
+        if (value > ctrl->maximum)
+            value = ctrl->maximum;
+        if (value != ctrl->value) {
+            ctrl->value = value;
+            ctrl->dirty = true;
+            c->dirty    = true;
+            changed     = true;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    return changed;
+}
+
+/* one batch of n is refused as a whole: ask TRY_EXT_CTRLS which control it is, -1 if none */
+static int find_rejected(int fd, struct v4l2_ext_controls* ext, int n)
+{
+    ext->error_idx = (uint32_t) n;
+    if (ioctl(fd, VIDIOC_TRY_EXT_CTRLS, ext) == 0)
+        return -1;
+    return ext->error_idx < (uint32_t) n ? (int) ext->error_idx : -1;
+}
+
+/* a batch that did not reach the driver goes out again with the next one */
+static void mark_dirty(struct axon_controls* c, const struct v4l2_ext_control* vals, int n)
+{
+    for (int i = 0; i < n; i++) {
+        struct axon_control* ctrl = find_control(c, vals[i].id);
+        if (ctrl) {
+            ctrl->dirty = true;
+            c->dirty    = true;
+        }
+    }
+}
+
+bool axon_controls_apply(struct axon_controls* c, int fd, int request_fd)
+{
+    if (!c->dirty)
+        return false;
+
+    struct v4l2_ext_control vals[AXON_MAX_CONTROLS];
+    int                     n = 0;
+
+    /* snapshot under the lock, talk to the driver without it */
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < c->count; i++) {
+        struct axon_control* ctrl = &c->controls[i];
+        if (!ctrl->dirty)
+            continue;
+        memset(&vals[n], 0, sizeof(vals[n]));
+        vals[n].id    = ctrl->id;
+        vals[n].value = (int32_t) ctrl->value;
+        n++;
+        ctrl->dirty = false;
+    }
+    c->dirty = false;
+    pthread_mutex_unlock(&c->lock);
+
+    /*
+     * WHICH_CUR_VAL lets one call mix control classes. If the driver rejects
+     * a control, error_idx names it: drop it and send the rest again. An
+     * error_idx of n means validation failed before anything was applied,
+     * and TRY_EXT_CTRLS narrows it down.
+     */
+    bool applied = false;
+    while (n > 0) {
+        struct v4l2_ext_controls ext;
+        memset(&ext, 0, sizeof(ext));
+        ext.which    = request_fd >= 0 ? V4L2_CTRL_WHICH_REQUEST_VAL : V4L2_CTRL_WHICH_CUR_VAL;
+        ext.count    = (uint32_t) n;
+        ext.controls = vals;
+        if (request_fd >= 0)
+            ext.request_fd = request_fd;
+        if (ioctl(fd, VIDIOC_S_EXT_CTRLS, &ext) == 0) {
+            applied = true;
+            break;
+        }
+
+        int err = errno;
+        int bad = (int) ext.error_idx;
+        if (bad >= n)
+            bad = find_rejected(fd, &ext, n);
+
+        pthread_mutex_lock(&c->lock);
+        bool first = !c->retrying;
+        c->failures++;
+        if (bad < 0) {
+            mark_dirty(c, vals, n);
+            c->retrying = true;
+        }
+        pthread_mutex_unlock(&c->lock);
+
+        /* retried on every frame until it goes through, so only the first is logged */
+        if (bad < 0) {
+            if (first)
+                blog(LOG_WARNING, "[axon] Failed to apply %d camera controls, retrying: %s", n,
+                     strerror(err));
+            break;
+        }
+        blog(LOG_WARNING, "[axon] Camera control 0x%08x rejected: %s", vals[bad].id,
+             strerror(err));
+        vals[bad] = vals[--n];
+    }
+
+    if (applied) {
+        pthread_mutex_lock(&c->lock);
+        c->batches++;
+        c->retrying = false;
+        pthread_mutex_unlock(&c->lock);
+    }
+    return applied;
+}
+
+static void control_key(uint32_t id, char* key, size_t size)
+{
+    snprintf(key, size, "ctrl_%08x", id);
+}
+
+void axon_controls_add_properties(struct axon_controls* c, obs_properties_t* props)
+{
+    char key[32];
+
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < c->count; i++) {
+        const struct axon_control* ctrl = &c->controls[i];
+        control_key(ctrl->id, key, sizeof(key));
+
+        if (ctrl->type == V4L2_CTRL_TYPE_BOOLEAN) {
+            obs_properties_add_bool(props, key, ctrl->name);
+        } else if (ctrl->num_items > 0) {
+            obs_property_t* list = obs_properties_add_list(props, key, ctrl->name,
+                                                           OBS_COMBO_TYPE_LIST,
+                                                           OBS_COMBO_FORMAT_INT);
+            for (int m = 0; m < ctrl->num_items; m++)
+                obs_property_list_add_int(list, ctrl->item_name[m], ctrl->item_index[m]);
+        } else {
+            obs_properties_add_int_slider(props, key, ctrl->name, (int) ctrl->minimum,
+                                          (int) ctrl->maximum, (int) ctrl->step);
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+void axon_controls_load_settings(struct axon_controls* c, obs_data_t* settings)
+{
+    char     key[32];
+    uint32_t ids[AXON_MAX_CONTROLS];
+    int64_t  values[AXON_MAX_CONTROLS];
+    int      n = 0;
+
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < c->count; i++) {
+        const struct axon_control* ctrl = &c->controls[i];
+        control_key(ctrl->id, key, sizeof(key));
+
+        if (ctrl->type == V4L2_CTRL_TYPE_BOOLEAN)
+            obs_data_set_default_bool(settings, key, ctrl->value != 0);
+        else
+            obs_data_set_default_int(settings, key, ctrl->value);
+        if (!obs_data_has_user_value(settings, key))
+            continue;
+
+        ids[n] = ctrl->id;
+        if (ctrl->type == V4L2_CTRL_TYPE_BOOLEAN)
+            values[n++] = obs_data_get_bool(settings, key) ? 1 : 0;
+        else
+            values[n++] = obs_data_get_int(settings, key);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    for (int i = 0; i < n; i++)
+        axon_controls_set(c, ids[i], values[i]);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <obs-module.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/*
+ * Camera controls (exposure, gain, white balance, focus, ISP tuning). The
+ * device is asked once per open which controls it has; after that the UI
+ * only ever touches the cache, and changes reach the driver in a single
+ * VIDIOC_S_EXT_CTRLS issued from the capture path between frames. Nothing
+ * here is called from the render path.
+ */
+
+#define AXON_MAX_CONTROLS 48
+#define AXON_MAX_MENU_ITEMS 16
+
+struct axon_control {
+    uint32_t id;
+    uint32_t type; /* V4L2_CTRL_TYPE_* */
+    char     name[32];
+    int64_t  minimum;
+    int64_t  maximum;
+    int64_t  step;
+    int64_t  default_value;
+    int64_t  value;
+    bool     dirty;
+
+    /* menu and integer menu entries; index is the control value */
+    int      num_items;
+    uint32_t item_index[AXON_MAX_MENU_ITEMS];
+    char     item_name[AXON_MAX_MENU_ITEMS][32];
+};
+
+struct axon_controls {
+    pthread_mutex_t     lock;
+    struct axon_control controls[AXON_MAX_CONTROLS];
+    int                 count;
+    volatile bool       dirty;
+
+    /* counters, under lock: apply runs on the loop thread and on pool workers */
+    uint64_t batches;
+    uint64_t failures;
+    bool     retrying;
+};
+
+void axon_controls_init(struct axon_controls* c);
+void axon_controls_free(struct axon_controls* c);
+
+/* query the device and read current values; replaces the cache */
+int  axon_controls_enumerate(struct axon_controls* c, int fd);
+void axon_controls_clear(struct axon_controls* c);
+
+/* cache only, never blocks on the device; false if the value did not change */
+bool axon_controls_set(struct axon_controls* c, uint32_t id, int64_t value);
+
+/*
+ * Capture path: push every pending change in one ioctl. With a request fd the
+ * changes are stored in that request and land on the buffer queued with it.
+ * True if anything was written.
+ */
+bool axon_controls_apply(struct axon_controls* c, int fd, int request_fd);
+
+/* settings keys are "ctrl_<id in hex>"; defaults follow the device's current values */
+void axon_controls_add_properties(struct axon_controls* c, obs_properties_t* props);
+void axon_controls_load_settings(struct axon_controls* c, obs_data_t* settings);
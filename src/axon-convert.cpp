@@ -0,0 +1,378 @@
+#include "axon-convert.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/* 16 rows of 256 BGRA pixels: a transpose tile stays in L1 and rows still vectorise */
+#define TRANSFORM_TILE_ROWS 16
+#define TRANSFORM_TILE_COLS 256
+
+/* NV15 rows are unpacked in chunks of this many output pixels, sized for the stack */
+#define NV15_CHUNK 256
+
+typedef void (*segment_fn)(uint8_t* out, const uint8_t* y_plane, const uint8_t* uv_plane,
+                           int y_stride, int uv_stride, int shift, int x, int y, int n,
+                           bool reverse);
+
+static inline uint8_t clamp_u8(int v)
+{
+    return (uint8_t) (v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/*
+ * How samples are stored: bytes, or 16-bit words with ten bits at the top.
+ * NV15 is unpacked to P010 words before it reaches the row kernels.
+ */
+template <enum axon_yuv_format F> struct yuv_samples {
+    typedef uint8_t type;
+    static const int shift = 0;
+    static const int bits  = 8;
+};
+
+template <> struct yuv_samples<AXON_YUV_P010> {
+    typedef uint16_t type;
+    static const int shift = 6;
+    static const int bits  = 10;
+};
+
+template <> struct yuv_samples<AXON_YUV_NV15> : yuv_samples<AXON_YUV_P010> {};
+
+static constexpr double matrix_kr(enum axon_matrix m)
+{
+    return m == AXON_MATRIX_BT709 ? 0.2126 : (m == AXON_MATRIX_BT2020 ? 0.2627 : 0.299);
+}
+
+static constexpr double matrix_kb(enum axon_matrix m)
+{
+    return m == AXON_MATRIX_BT709 ? 0.0722 : (m == AXON_MATRIX_BT2020 ? 0.0593 : 0.114);
+}
+
+static constexpr int fixed8(double v)
+{
+    return (int) (v * 256.0 + 0.5);
+}
+
+/*
+ * 8.8 fixed point YCbCr -> RGB coefficients, worked out by the compiler.
+ * Limited range stretches 219 luma and 224 chroma steps over 255, which
+ * for BT.601 gives the familiar 298/409/100/208/516.
+ */
+template <enum axon_matrix M, enum axon_range R> struct yuv_coeffs {
+    static constexpr double kr = matrix_kr(M);
+    static constexpr double kb = matrix_kb(M);
+    static constexpr double kg = 1.0 - kr - kb;
+    static constexpr double ys = R == AXON_RANGE_FULL ? 1.0 : 255.0 / 219.0;
+    static constexpr double cs = R == AXON_RANGE_FULL ? 1.0 : 255.0 / 224.0;
+
+    static constexpr int y     = fixed8(ys);
+    static constexpr int rv    = fixed8(2.0 * (1.0 - kr) * cs);
+    static constexpr int gu    = fixed8(2.0 * (1.0 - kb) * kb / kg * cs);
+    static constexpr int gv    = fixed8(2.0 * (1.0 - kr) * kr / kg * cs);
+    static constexpr int bu    = fixed8(2.0 * (1.0 - kb) * cs);
+    static constexpr int black = R == AXON_RANGE_FULL ? 0 : 16;
+};
+
+template <enum axon_rgb_layout L> static inline void store_pixel(uint8_t* px, int r, int g, int b)
+{
+    px[L == AXON_RGB_RGBA ? 0 : 2] = clamp_u8(r);
+    px[1]                          = clamp_u8(g);
+    px[L == AXON_RGB_RGBA ? 2 : 0] = clamp_u8(b);
+    if (L != AXON_RGB_BGRX)
+        px[3] = 255;
+}
+
+/*
+ * One pixel from luma c and chroma d/e, already offset to zero black and
+ * centred chroma. 10-bit input keeps its two extra bits through the matrix
+ * and rounds once to 8 bits at the end, which bands less than truncating
+ * to 8 bits first.
+ */
+template <enum axon_yuv_format F, enum axon_matrix M, enum axon_range R, enum axon_rgb_layout L>
+static inline void yuv_pixel(uint8_t* px, int c, int d, int e)
+{
+    typedef yuv_coeffs<M, R> K;
+    const int                shift = yuv_samples<F>::bits;
+    const int                round = 1 << (shift - 1);
+
+    store_pixel<L>(px, (K::y * c + K::rv * e + round) >> shift,
+                   (K::y * c - K::gu * d - K::gv * e + round) >> shift,
+                   (K::y * c + K::bu * d + round) >> shift);
+}
+
+/*
+ * One row (or row segment starting on an even column) at full resolution.
+ * reverse writes it right to left, which costs nothing over a forward store
+ * and saves a separate mirroring pass.
+ */
+template <enum axon_yuv_format F, enum axon_matrix M, enum axon_range R, enum axon_rgb_layout L>
+static inline void convert_row(uint8_t* out, const typename yuv_samples<F>::type* y_row,
+                               const typename yuv_samples<F>::type* uv_row, int width,
+                               bool reverse)
+{
+    typedef yuv_samples<F> S;
+    const int              extra  = S::bits - 8;
+    const int              black  = yuv_coeffs<M, R>::black << extra;
+    const int              centre = 128 << extra;
+
+    for (int i = 0; i < width; i++) {
+        int c = (y_row[i] >> S::shift) - black;
+        int d = (uv_row[(i / 2) * 2] >> S::shift) - centre;
+        int e = (uv_row[(i / 2) * 2 + 1] >> S::shift) - centre;
+        int o = reverse ? width - 1 - i : i;
+
+        yuv_pixel<F, M, R, L>(out + 4 * o, c, d, e);
+    }
+}
+
+/*
+ * One output row of the block-averaging downscale; pitches are in samples.
+ * Samples are shifted down before they are summed, so junk in the unused
+ * low bits of P010 words cannot carry into the average.
+ */
+template <enum axon_yuv_format F, enum axon_matrix M, enum axon_range R, enum axon_rgb_layout L>
+static inline void convert_scaled_row(uint8_t* out, const typename yuv_samples<F>::type* y_rows,
+                                      const typename yuv_samples<F>::type* uv_rows,
+                                      int out_width, int y_pitch, int uv_pitch, int shift,
+                                      bool reverse)
+{
+    typedef yuv_samples<F> S;
+    const int              extra  = S::bits - 8;
+    const int              black  = yuv_coeffs<M, R>::black << extra;
+    const int              centre = 128 << extra;
+
+    int block    = 1 << shift;
+    int c_block  = block / 2;
+    int y_shift  = 2 * shift;
+    int uv_shift = 2 * (shift - 1);
+
+    for (int i = 0; i < out_width; i++) {
+        int ysum = 0;
+        for (int dy = 0; dy < block; dy++) {
+            const typename S::type* yp = y_rows + (size_t) dy * y_pitch + i * block;
+            for (int dx = 0; dx < block; dx++)
+                ysum += yp[dx] >> S::shift;
+        }
+
+        int usum = 0, vsum = 0;
+        for (int dy = 0; dy < c_block; dy++) {
+            const typename S::type* uvp = uv_rows + (size_t) dy * uv_pitch + i * c_block * 2;
+            for (int dx = 0; dx < c_block; dx++) {
+                usum += uvp[2 * dx] >> S::shift;
+                vsum += uvp[2 * dx + 1] >> S::shift;
+            }
+        }
+
+        int o = reverse ? out_width - 1 - i : i;
+        yuv_pixel<F, M, R, L>(out + 4 * o, (ysum >> y_shift) - black, (usum >> uv_shift) - centre,
+                              (vsum >> uv_shift) - centre);
+    }
+}
+
+/* n output pixels from rows whose pitch is given in samples */
+template <enum axon_yuv_format F, enum axon_matrix M, enum axon_range R, enum axon_rgb_layout L>
+static inline void convert_run(uint8_t* out, const typename yuv_samples<F>::type* y_row,
+                               const typename yuv_samples<F>::type* uv_row, int y_pitch,
+                               int uv_pitch, int shift, int n, bool reverse)
+{
+    /* constant flags so each direction gets its own vectorised loop */
+    if (!shift) {
+        if (reverse)
+            convert_row<F, M, R, L>(out, y_row, uv_row, n, true);
+        else
+            convert_row<F, M, R, L>(out, y_row, uv_row, n, false);
+    } else if (reverse) {
+        convert_scaled_row<F, M, R, L>(out, y_row, uv_row, n, y_pitch, uv_pitch, shift, true);
+    } else {
+        convert_scaled_row<F, M, R, L>(out, y_row, uv_row, n, y_pitch, uv_pitch, shift, false);
+    }
+}
+
+/*
+ * NV15 packs four 10-bit samples into five bytes, little endian. Each group
+ * is pulled out of one 64-bit load with shifts and masks; every full group
+ * but the last is read with an 8-byte load, which never leaves the row.
+ * first must be a multiple of four.
+ */
+static inline void unpack_nv15(uint16_t* out, const uint8_t* row, int first, int count)
+{
+    const uint8_t* p = row + (size_t) (first / 4) * 5;
+    int            i = 0;
+
+    for (; i + 8 <= count; i += 4, p += 5) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        out[i + 0] = (uint16_t) ((v & 0x3ff) << 6);
+        out[i + 1] = (uint16_t) (((v >> 10) & 0x3ff) << 6);
+        out[i + 2] = (uint16_t) (((v >> 20) & 0x3ff) << 6);
+        out[i + 3] = (uint16_t) (((v >> 30) & 0x3ff) << 6);
+    }
+    for (; i < count; i += 4, p += 5) {
+        int      left  = count - i < 4 ? count - i : 4;
+        int      bytes = (left * 10 + 7) / 8;
+        uint64_t v     = 0;
+        for (int k = 0; k < bytes; k++)
+            v |= (uint64_t) p[k] << (8 * k);
+        for (int k = 0; k < left; k++)
+            out[i + k] = (uint16_t) (((v >> (10 * k)) & 0x3ff) << 6);
+    }
+}
+
+template <enum axon_matrix M, enum axon_range R, enum axon_rgb_layout L>
+static void convert_segment_nv15(uint8_t* out, const uint8_t* y_plane, const uint8_t* uv_plane,
+                                 int y_stride, int uv_stride, int shift, int x, int y, int n,
+                                 bool reverse)
+{
+    int block   = 1 << shift;
+    int c_block = block > 1 ? block / 2 : 1;
+    int c_row   = shift ? y * c_block : y / 2;
+
+    uint16_t y_buf[4][NV15_CHUNK << 2];
+    uint16_t uv_buf[2][NV15_CHUNK << 2];
+
+    for (int k = 0; k < n; k += NV15_CHUNK) {
+        int chunk   = n - k < NV15_CHUNK ? n - k : NV15_CHUNK;
+        int first   = (x + k) * block;
+        int samples = chunk * block;
+
+        for (int dy = 0; dy < block; dy++)
+            unpack_nv15(y_buf[dy], y_plane + (size_t) (y * block + dy) * y_stride, first, samples);
+        for (int dy = 0; dy < c_block; dy++)
+            unpack_nv15(uv_buf[dy], uv_plane + (size_t) (c_row + dy) * uv_stride, first,
+                        (samples + 1) & ~1);
+
+        /* reversed, chunk k fills the output from the right */
+        uint8_t* o = out + 4 * (size_t) (reverse ? n - k - chunk : k);
+        convert_run<AXON_YUV_P010, M, R, L>(o, y_buf[0], uv_buf[0], NV15_CHUNK << 2,
+                                            NV15_CHUNK << 2, shift, chunk, reverse);
+    }
+}
+
+/* n pixels of row y starting at column x, in units of the (shifted) output grid */
+template <enum axon_yuv_format F, enum axon_matrix M, enum axon_range R, enum axon_rgb_layout L>
+static void convert_segment(uint8_t* out, const uint8_t* y_plane, const uint8_t* uv_plane,
+                            int y_stride, int uv_stride, int shift, int x, int y, int n,
+                            bool reverse)
+{
+    typedef typename yuv_samples<F>::type T;
+
+    if (F == AXON_YUV_NV15) {
+        convert_segment_nv15<M, R, L>(out, y_plane, uv_plane, y_stride, uv_stride, shift, x, y,
+                                      n, reverse);
+        return;
+    }
+
+    int block   = 1 << shift;
+    int c_block = block > 1 ? block / 2 : 1;
+    int c_row   = shift ? y * c_block : y / 2;
+
+    const T* y_row  = (const T*) (y_plane + (size_t) y * block * y_stride) + x * block;
+    const T* uv_row = (const T*) (uv_plane + (size_t) c_row * uv_stride) + x * block;
+    convert_run<F, M, R, L>(out, y_row, uv_row, y_stride / (int) sizeof(T),
+                            uv_stride / (int) sizeof(T), shift, n, reverse);
+}
+
+/* every combination, indexed [format][matrix][range][layout] */
+#define SEGMENT_LAYOUTS(f, m, r)                                                                 \
+    {                                                                                            \
+        convert_segment<f, m, r, AXON_RGB_BGRA>, convert_segment<f, m, r, AXON_RGB_RGBA>,        \
+            convert_segment<f, m, r, AXON_RGB_BGRX>,                                             \
+    }
+#define SEGMENT_RANGES(f, m)                                                                     \
+    {                                                                                            \
+        SEGMENT_LAYOUTS(f, m, AXON_RANGE_LIMITED), SEGMENT_LAYOUTS(f, m, AXON_RANGE_FULL),       \
+    }
+#define SEGMENT_MATRICES(f)                                                                      \
+    {                                                                                            \
+        SEGMENT_RANGES(f, AXON_MATRIX_BT601), SEGMENT_RANGES(f, AXON_MATRIX_BT709),              \
+            SEGMENT_RANGES(f, AXON_MATRIX_BT2020),                                               \
+    }
+
+static const segment_fn segments[AXON_YUV_FORMATS][AXON_MATRICES][AXON_RANGES][AXON_RGB_LAYOUTS] = {
+    SEGMENT_MATRICES(AXON_YUV_NV12),
+    SEGMENT_MATRICES(AXON_YUV_P010),
+    SEGMENT_MATRICES(AXON_YUV_NV15),
+};
+
+static void transform_rows(segment_fn convert, uint8_t* dst, const uint8_t* y_plane,
+                           const uint8_t* uv_plane, int src_width, int src_height, int y_stride,
+                           int uv_stride, int shift, const struct axon_transform* t,
+                           const struct axon_lut* lut, int row_begin, int row_end)
+{
+    int rotation = t->rotation & 3;
+
+    /* 0/180: each source row is one output row, stored right to left if mirrored */
+    if (!axon_transform_swaps_axes(t)) {
+        bool upside_down = (rotation == 2) != t->vflip;
+        bool mirrored    = (rotation == 2) != t->hflip;
+
+        for (int y = row_begin; y < row_end; y++) {
+            int      j   = upside_down ? src_height - 1 - y : y;
+            uint8_t* out = dst + (size_t) j * (size_t) src_width * 4;
+            convert(out, y_plane, uv_plane, y_stride, uv_stride, shift, 0, y, src_width, mirrored);
+            if (lut)
+                axon_lut_apply(lut, out, src_width);
+        }
+        return;
+    }
+
+    /*
+     * 90/270: source row y lands in output column i = i0 + di * y and source
+     * column x in output row j = j0 + dj * x. A tile of source rows is
+     * converted in order, then each of its columns is written out as one
+     * short contiguous run of an output row.
+     */
+    int  out_width = src_height;
+    bool flip_i    = (rotation == 1) != t->hflip;
+    bool flip_j    = (rotation == 3) != t->vflip;
+    int  i0        = flip_i ? src_height - 1 : 0;
+    int  di        = flip_i ? -1 : 1;
+    int  j0        = flip_j ? src_width - 1 : 0;
+    int  dj        = flip_j ? -1 : 1;
+
+    uint32_t tile[TRANSFORM_TILE_ROWS][TRANSFORM_TILE_COLS];
+
+    for (int yb = row_begin; yb < row_end; yb += TRANSFORM_TILE_ROWS) {
+        int ye = yb + TRANSFORM_TILE_ROWS < row_end ? yb + TRANSFORM_TILE_ROWS : row_end;
+
+        for (int xb = 0; xb < src_width; xb += TRANSFORM_TILE_COLS) {
+            int n = xb + TRANSFORM_TILE_COLS < src_width ? TRANSFORM_TILE_COLS : src_width - xb;
+
+            for (int y = yb; y < ye; y++) {
+                convert((uint8_t*) tile[y - yb], y_plane, uv_plane, y_stride, uv_stride, shift, xb,
+                        y, n, false);
+                if (lut)
+                    axon_lut_apply(lut, (uint8_t*) tile[y - yb], n);
+            }
+
+            for (int x = xb; x < xb + n; x++) {
+                uint32_t* out = (uint32_t*) (dst + (size_t) (j0 + dj * x) * out_width * 4);
+                for (int y = yb; y < ye; y++)
+                    out[i0 + di * y] = tile[y - yb][x - xb];
+            }
+        }
+    }
+}
+
+void axon_convert_rows(const struct axon_convert_format* f, uint8_t* dst, const uint8_t* y_plane,
+                       const uint8_t* uv_plane, int src_width, int src_height, int y_stride,
+                       int uv_stride, int shift, const struct axon_transform* t,
+                       const struct axon_lut* lut, int row_begin, int row_end)
+{
+    segment_fn convert = segments[f->yuv][f->matrix][f->range][f->layout];
+    transform_rows(convert, dst, y_plane, uv_plane, src_width, src_height, y_stride, uv_stride,
+                   shift, t, lut, row_begin, row_end);
+}
+
+void nv15_to_p010_rows(uint16_t* y_dst, uint16_t* uv_dst, const uint8_t* y_plane,
+                       const uint8_t* uv_plane, int width, int y_stride, int uv_stride,
+                       int row_begin, int row_end)
+{
+    int uv_width = (width + 1) & ~1;
+    for (int j = row_begin; j < row_end; j++) {
+        unpack_nv15(y_dst + (size_t) j * width, y_plane + (size_t) j * y_stride, 0, width);
+        if (!(j & 1)) {
+            unpack_nv15(uv_dst + (size_t) (j / 2) * uv_width,
+                        uv_plane + (size_t) (j / 2) * uv_stride, 0, uv_width);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "axon-lut.h"
+
+/*
+ * YCbCr 4:2:0 -> packed RGB conversion. dst is tightly packed, four bytes
+ * per pixel. Every kernel is a template over the input format, the YCbCr
+ * matrix and range, and the output byte order; axon_convert_rows picks the
+ * instantiation from a table once per call, so the per-pixel loops carry
+ * no format or colour branches. Rows [row_begin, row_end) are converted so
+ * a frame can be split into stripes across pool workers; row_begin should
+ * be even so stripes never share a chroma row.
+ */
+
+enum axon_yuv_format {
+    AXON_YUV_NV12 = 0,
+    AXON_YUV_P010, /* 10 bits in the top of each 16-bit sample */
+    AXON_YUV_NV15, /* four 10-bit samples packed into five bytes */
+    AXON_YUV_FORMATS,
+};
+
+enum axon_matrix {
+    AXON_MATRIX_BT601 = 0,
+    AXON_MATRIX_BT709,
+    AXON_MATRIX_BT2020, /* non-constant luminance */
+    AXON_MATRICES,
+};
+
+enum axon_range {
+    AXON_RANGE_LIMITED = 0,
+    AXON_RANGE_FULL,
+    AXON_RANGES,
+};
+
+enum axon_rgb_layout {
+    AXON_RGB_BGRA = 0, /* opaque alpha */
+    AXON_RGB_RGBA,     /* opaque alpha */
+    AXON_RGB_BGRX,     /* fourth byte unspecified, for targets that ignore alpha */
+    AXON_RGB_LAYOUTS,
+};
+
+struct axon_convert_format {
+    enum axon_yuv_format yuv;
+    enum axon_matrix     matrix;
+    enum axon_range      range;
+    enum axon_rgb_layout layout;
+};
+
+/*
+ * Rotation (clockwise, in quarter turns) and mirroring, fused into the
+ * conversion so a mounted-upside-down camera costs no extra pass. Mirroring
+ * applies after rotation, to the output image.
+ */
+struct axon_transform {
+    int  rotation; /* 0..3 */
+    bool hflip;
+    bool vflip;
+};
+
+static inline bool axon_transform_is_identity(const struct axon_transform* t)
+{
+    return !(t->rotation & 3) && !t->hflip && !t->vflip;
+}
+
+static inline bool axon_transform_swaps_axes(const struct axon_transform* t)
+{
+    return (t->rotation & 1) != 0;
+}
+
+/*
+ * Convert and transform. src_width/src_height are the frame size at this
+ * shift: shift 1/2 averages every (1 << shift) square of luma and the
+ * matching chroma, so a half or quarter size frame costs a fraction of a
+ * full conversion. [row_begin, row_end) are source rows at this shift, so
+ * stripes split the frame the same way whatever the transform; the output
+ * is the transformed frame, src_height wide for 90/270. Rotated frames are
+ * converted in small tiles of source rows that are then written out
+ * transposed, so reads stay sequential. A non-NULL lut grades each row or
+ * tile right after conversion, while it is still in L1; it reads BGRA
+ * order, so it needs the BGRA or BGRX layout. Strides are in bytes.
+ */
+void axon_convert_rows(const struct axon_convert_format* f, uint8_t* dst, const uint8_t* y_plane,
+                       const uint8_t* uv_plane, int src_width, int src_height, int y_stride,
+                       int uv_stride, int shift, const struct axon_transform* t,
+                       const struct axon_lut* lut, int row_begin, int row_end);
+
+/* NV15 -> P010 rows for passthrough; dst planes are tightly packed (width samples per row) */
+void nv15_to_p010_rows(uint16_t* y_dst, uint16_t* uv_dst, const uint8_t* y_plane,
+                       const uint8_t* uv_plane, int width, int y_stride, int uv_stride,
+                       int row_begin, int row_end);
@@ -0,0 +1,166 @@
+#include "axon-deinterlace.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Adaptive mode: a line of the other field is replaced when it lies outside
+ * both kept neighbours by more than this (product of the two differences),
+ * which is what moving edges look like and noise mostly does not.
+ */
+#define DEINTERLACE_COMB_THRESHOLD 100
+
+/* ... and when it or a kept neighbour changed by more than this since the previous frame */
+#define DEINTERLACE_MOTION_THRESHOLD 12
+
+static const char* mode_names[] = {
+    "off",
+    "bob",
+    "blend",
+    "adaptive",
+};
+
+enum axon_deinterlace_mode axon_deinterlace_mode_from_string(const char* str)
+{
+    for (size_t i = 0; str && i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+        if (!strcmp(str, mode_names[i]))
+            return (enum axon_deinterlace_mode) i;
+    }
+    return AXON_DEINTERLACE_OFF;
+}
+
+/* row r of one field of a plane with frame_rows rows, clamped to the field */
+static inline const uint8_t* field_row(const uint8_t* plane, int stride, int frame_rows,
+                                       bool sequential, int field, int r)
+{
+    int rows = (frame_rows + 1 - field) / 2;
+    if (r > rows - 1)
+        r = rows - 1;
+    if (r < 0)
+        r = 0;
+    if (sequential)
+        return plane + ((size_t) field * ((frame_rows + 1) / 2) + r) * stride;
+    return plane + (size_t) (2 * r + field) * stride;
+}
+
+/* row j of the frame as captured, fields woven back together */
+static inline const uint8_t* woven_row(const uint8_t* plane, int stride, int frame_rows,
+                                       bool sequential, int j)
+{
+    if (j < 0)
+        j = 0;
+    if (j > frame_rows - 1)
+        j = frame_rows - 1;
+    return field_row(plane, stride, frame_rows, sequential, j & 1, j >> 1);
+}
+
+/* plain byte loops: the compiler vectorises all of these */
+static inline void average_row(uint8_t* out, const uint8_t* a, const uint8_t* b, int n)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = (uint8_t) ((a[i] + b[i] + 1) >> 1);
+}
+
+static inline void blend_row(uint8_t* out, const uint8_t* a, const uint8_t* b, const uint8_t* c,
+                             int n)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = (uint8_t) ((a[i] + 2 * b[i] + c[i] + 2) >> 2);
+}
+
+static inline int abs_diff(int a, int b)
+{
+    return a > b ? a - b : b - a;
+}
+
+/* prev_* are the same rows of the previous frame, or NULL to go on combing alone */
+static inline void adaptive_row(uint8_t* out, const uint8_t* above, const uint8_t* other,
+                                const uint8_t* below, const uint8_t* prev_above,
+                                const uint8_t* prev_other, const uint8_t* prev_below, int n)
+{
+    if (!prev_other) {
+        for (int i = 0; i < n; i++) {
+            int a = above[i], c = other[i], b = below[i];
+            out[i] = (a - c) * (b - c) > DEINTERLACE_COMB_THRESHOLD
+                         ? (uint8_t) ((a + b + 1) >> 1)
+                         : (uint8_t) c;
+        }
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        int  a      = above[i], c = other[i], b = below[i];
+        int  motion = abs_diff(c, prev_other[i]);
+        int  da     = abs_diff(a, prev_above[i]);
+        int  db     = abs_diff(b, prev_below[i]);
+        motion      = motion > da ? motion : da;
+        motion      = motion > db ? motion : db;
+        bool moved  = motion > DEINTERLACE_MOTION_THRESHOLD;
+        bool combed = (a - c) * (b - c) > DEINTERLACE_COMB_THRESHOLD;
+        out[i]      = moved && combed ? (uint8_t) ((a + b + 1) >> 1) : (uint8_t) c;
+    }
+}
+
+void axon_deinterlace_rows(uint8_t* y_dst, uint8_t* uv_dst, const uint8_t* y_plane,
+                           const uint8_t* uv_plane, const uint8_t* y_prev, int width, int height,
+                           int y_stride, int uv_stride, const struct axon_fields* fields,
+                           enum axon_deinterlace_mode mode, int field, int row_begin, int row_end)
+{
+    bool seq      = fields->sequential;
+    int  uv_rows  = height / 2;
+    int  uv_width = (width + 1) & ~1;
+
+    for (int j = row_begin; j < row_end; j++) {
+        uint8_t* out  = y_dst + (size_t) j * y_stride;
+        bool     kept = (j & 1) == field;
+
+        /* neighbours of a missing line within the kept field: woven rows j - 1 and j + 1 */
+        int            up    = (j - 1 - field) / 2;
+        int            down  = (j + 1 - field) / 2;
+        const uint8_t* above = field_row(y_plane, y_stride, height, seq, field, up);
+        const uint8_t* below = field_row(y_plane, y_stride, height, seq, field, down);
+
+        switch (mode) {
+        case AXON_DEINTERLACE_OFF:
+            memcpy(out, woven_row(y_plane, y_stride, height, seq, j), width);
+            break;
+        case AXON_DEINTERLACE_BOB:
+            if (kept)
+                memcpy(out, field_row(y_plane, y_stride, height, seq, field, j >> 1), width);
+            else
+                average_row(out, above, below, width);
+            break;
+        case AXON_DEINTERLACE_BLEND:
+            blend_row(out, woven_row(y_plane, y_stride, height, seq, j - 1),
+                      woven_row(y_plane, y_stride, height, seq, j),
+                      woven_row(y_plane, y_stride, height, seq, j + 1), width);
+            break;
+        case AXON_DEINTERLACE_ADAPTIVE:
+            if (kept)
+                memcpy(out, field_row(y_plane, y_stride, height, seq, field, j >> 1), width);
+            else if (y_prev)
+                adaptive_row(out, above, woven_row(y_plane, y_stride, height, seq, j), below,
+                             field_row(y_prev, y_stride, height, seq, field, up),
+                             woven_row(y_prev, y_stride, height, seq, j),
+                             field_row(y_prev, y_stride, height, seq, field, down), width);
+            else
+                adaptive_row(out, above, woven_row(y_plane, y_stride, height, seq, j), below,
+                             NULL, NULL, NULL, width);
+            break;
+        }
+    }
+
+    /* chroma is vertically subsampled already; take it from the shown field, or mix both */
+    for (int c = row_begin / 2; c < (row_end + 1) / 2 && c < uv_rows; c++) {
+        uint8_t* out = uv_dst + (size_t) c * uv_stride;
+
+        if (mode == AXON_DEINTERLACE_OFF) {
+            memcpy(out, woven_row(uv_plane, uv_stride, uv_rows, seq, c), uv_width);
+        } else if (mode == AXON_DEINTERLACE_BLEND) {
+            average_row(out, field_row(uv_plane, uv_stride, uv_rows, seq, 0, c >> 1),
+                        field_row(uv_plane, uv_stride, uv_rows, seq, 1, c >> 1), uv_width);
+        } else {
+            memcpy(out, field_row(uv_plane, uv_stride, uv_rows, seq, field, c >> 1), uv_width);
+        }
+    }
+}
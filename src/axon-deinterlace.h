@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Deinterlacing for sources that deliver both fields of a frame in one
+ * buffer. The deinterlacer writes progressive NV12 rows, a stripe at a time,
+ * into a copy with the same strides; the stripe is then converted by the
+ * usual kernels while it is still in cache, so rotation, downscaling and
+ * LUTs all work unchanged on interlaced input.
+ */
+
+enum axon_deinterlace_mode {
+    AXON_DEINTERLACE_OFF = 0,  /* weave the fields as captured */
+    AXON_DEINTERLACE_BOB,      /* one output frame per field, missing lines interpolated */
+    AXON_DEINTERLACE_BLEND,    /* 1-2-1 vertical filter over the woven frame */
+    AXON_DEINTERLACE_ADAPTIVE, /* weave, interpolating where the picture moved and combs */
+};
+
+/* where the fields live in the buffer and which was captured first */
+struct axon_fields {
+    bool sequential;   /* SEQ_TB/SEQ_BT: whole top field, then whole bottom field */
+    bool bottom_first; /* INTERLACED_BT, SEQ_BT, or INTERLACED on a 525-line standard */
+};
+
+enum axon_deinterlace_mode axon_deinterlace_mode_from_string(const char* str);
+
+/*
+ * Progressive rows [row_begin, row_end) of the frame; row_begin must be even.
+ * field (0 top, 1 bottom) is the one shown by bob and kept by adaptive. The
+ * destination planes use y_stride/uv_stride like the source.
+ *
+ * y_prev is the luma of the previous frame as captured, in the same layout,
+ * or NULL when there is none. Adaptive mode compares against it so static
+ * detail (text, fine stripes) is woven untouched and only lines that moved
+ * and comb are interpolated; without it, combing alone decides.
+ */
+void axon_deinterlace_rows(uint8_t* y_dst, uint8_t* uv_dst, const uint8_t* y_plane,
+                           const uint8_t* uv_plane, const uint8_t* y_prev, int width, int height,
+                           int y_stride, int uv_stride, const struct axon_fields* fields,
+                           enum axon_deinterlace_mode mode, int field, int row_begin, int row_end);
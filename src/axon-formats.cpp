@@ -0,0 +1,164 @@
+#include "axon-formats.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#define FORMATS_FILE "formats.txt"
+
+/* oldest entries are dropped first once the table is full */
+#define FORMATS_MAX 64
+
+struct format_entry {
+    char                      key[AXON_FORMAT_KEY];
+    struct axon_cached_format format;
+};
+
+static struct {
+    pthread_mutex_t     lock;
+    bool                loaded;
+    int                 count;
+    struct format_entry entries[FORMATS_MAX];
+} formats = {PTHREAD_MUTEX_INITIALIZER, false, 0, {}};
+
+/*
+ * One entry per line: the key, a tab, then fourcc, width, height, field,
+ * planes, bytesperline and sizeimage of each plane, and the buffer count.
+ */
+static void load_formats(void)
+{
+    formats.loaded = true;
+
+    char* path = obs_module_config_path(FORMATS_FILE);
+    FILE* f    = path ? fopen(path, "r") : NULL;
+    bfree(path);
+    if (!f)
+        return;
+
+    char line[AXON_FORMAT_KEY + 160];
+    while (formats.count < FORMATS_MAX && fgets(line, sizeof(line), f)) {
+        char* tab = strchr(line, '\t');
+        if (!tab || tab - line >= AXON_FORMAT_KEY)
+            continue;
+
+        struct format_entry*       e = &formats.entries[formats.count];
+        struct axon_cached_format* c = &e->format;
+        if (sscanf(tab + 1, "%u %u %u %u %u %u %u %u %u %u", &c->fourcc, &c->width, &c->height,
+                   &c->field, &c->num_planes, &c->bytesperline[0], &c->sizeimage[0],
+                   &c->bytesperline[1], &c->sizeimage[1], &c->num_buffers) != 10)
+            continue;
+        if (!c->num_planes || c->num_planes > AXON_FORMAT_PLANES || !c->num_buffers)
+            continue;
+
+        memcpy(e->key, line, (size_t) (tab - line));
+        e->key[tab - line] = 0;
+        formats.count++;
+    }
+    fclose(f);
+}
+
+/* written to a temporary file and renamed, so a crash never leaves half a cache */
+static void save_formats(void)
+{
+    char* dir = obs_module_config_path("");
+    if (dir) {
+        os_mkdirs(dir);
+        bfree(dir);
+    }
+
+    char* path = obs_module_config_path(FORMATS_FILE);
+    char* tmp  = obs_module_config_path(FORMATS_FILE ".tmp");
+    FILE* f    = tmp ? fopen(tmp, "w") : NULL;
+    if (!f) {
+        blog(LOG_WARNING, "[axon] Cannot write the format cache %s", path ? path : "");
+        bfree(path);
+        bfree(tmp);
+        return;
+    }
+
+    for (int i = 0; i < formats.count; i++) {
+        const struct axon_cached_format* c = &formats.entries[i].format;
+        fprintf(f, "%s\t%u %u %u %u %u %u %u %u %u %u\n", formats.entries[i].key, c->fourcc,
+                c->width, c->height, c->field, c->num_planes, c->bytesperline[0],
+                c->sizeimage[0], c->bytesperline[1], c->sizeimage[1], c->num_buffers);
+    }
+    bool ok = fclose(f) == 0;
+    if (ok)
+        ok = os_rename(tmp, path) == 0;
+    if (!ok) {
+        blog(LOG_WARNING, "[axon] Cannot write the format cache %s", path);
+        os_unlink(tmp);
+    }
+    bfree(path);
+    bfree(tmp);
+}
+
+static int find_entry(const char* key)
+{
+    for (int i = 0; i < formats.count; i++) {
+        if (!strcmp(formats.entries[i].key, key))
+            return i;
+    }
+    return -1;
+}
+
+static void remove_entry(int i)
+{
+    memmove(&formats.entries[i], &formats.entries[i + 1],
+            (size_t) (formats.count - i - 1) * sizeof(formats.entries[0]));
+    formats.count--;
+}
+
+bool axon_formats_lookup(const char* key, struct axon_cached_format* f)
+{
+    pthread_mutex_lock(&formats.lock);
+    if (!formats.loaded)
+        load_formats();
+    int i = find_entry(key);
+    if (i >= 0)
+        *f = formats.entries[i].format;
+    pthread_mutex_unlock(&formats.lock);
+    return i >= 0;
+}
+
+void axon_formats_store(const char* key, const struct axon_cached_format* f)
+{
+    if (!key[0] || strlen(key) >= AXON_FORMAT_KEY || strpbrk(key, "\t\n"))
+        return;
+
+    pthread_mutex_lock(&formats.lock);
+    if (!formats.loaded)
+        load_formats();
+
+    int i = find_entry(key);
+    if (i >= 0 && !memcmp(&formats.entries[i].format, f, sizeof(*f))) {
+        pthread_mutex_unlock(&formats.lock);
+        return;
+    }
+    if (i >= 0)
+        remove_entry(i);
+    else if (formats.count == FORMATS_MAX)
+        remove_entry(0);
+
+    /* newest last */
+    struct format_entry* e = &formats.entries[formats.count++];
+    snprintf(e->key, sizeof(e->key), "%s", key);
+    e->format = *f;
+    save_formats();
+    pthread_mutex_unlock(&formats.lock);
+}
+
+void axon_formats_forget(const char* key)
+{
+    pthread_mutex_lock(&formats.lock);
+    if (!formats.loaded)
+        load_formats();
+    int i = find_entry(key);
+    if (i >= 0) {
+        remove_entry(i);
+        save_formats();
+    }
+    pthread_mutex_unlock(&formats.lock);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Capture formats that negotiated successfully before, kept in the plugin
+ * config directory so the next launch can go straight to them instead of
+ * walking the candidate list (S_FMT alone takes hundreds of milliseconds on
+ * some drivers). Entries are keyed by the device identity and what was
+ * asked of it; the caller checks a cached format against the device and
+ * negotiates in full on any mismatch, so a stale entry only costs a lookup.
+ *
+ * Safe to call from several device tasks at once.
+ */
+
+#define AXON_FORMAT_PLANES 2
+#define AXON_FORMAT_KEY    192
+
+struct axon_cached_format {
+    uint32_t fourcc;
+    uint32_t width;
+    uint32_t height;
+    uint32_t field;
+    uint32_t num_planes;
+    uint32_t bytesperline[AXON_FORMAT_PLANES];
+    uint32_t sizeimage[AXON_FORMAT_PLANES];
+    uint32_t num_buffers;
+};
+
+/* false when nothing is known for key */
+bool axon_formats_lookup(const char* key, struct axon_cached_format* f);
+
+/* remember f for key and write the cache out if it changed */
+void axon_formats_store(const char* key, const struct axon_cached_format* f);
+
+/* drop key, after its cached format failed to start */
+void axon_formats_forget(const char* key);
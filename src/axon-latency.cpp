@@ -0,0 +1,212 @@
+#include "axon-latency.h"
+
+#include <graphics/graphics.h>
+#include <util/platform.h>
+#include <string.h>
+
+#define LATENCY_MASK ((1u << AXON_LATENCY_BITS) - 1)
+#define LATENCY_MAX_MS 10000
+#define LATENCY_MIN_CONTRAST 40
+
+uint32_t axon_latency_time_ms(uint64_t ns)
+{
+    return (uint32_t) (ns / 1000000ULL) & LATENCY_MASK;
+}
+
+void axon_latency_encode(uint32_t time_ms, bool cells[AXON_LATENCY_CELLS])
+{
+    uint32_t gray   = (time_ms ^ (time_ms >> 1)) & LATENCY_MASK;
+    bool     parity = false;
+
+    cells[0] = true;
+    cells[1] = false;
+    for (int i = 0; i < AXON_LATENCY_BITS; i++) {
+        bool bit     = (gray >> (AXON_LATENCY_BITS - 1 - i)) & 1;
+        cells[2 + i] = bit;
+        parity ^= bit;
+    }
+    cells[2 + AXON_LATENCY_BITS]  = parity;
+    cells[AXON_LATENCY_CELLS - 2] = false;
+    cells[AXON_LATENCY_CELLS - 1] = true;
+}
+
+bool axon_latency_decode(const uint8_t* row, int width, uint32_t* time_ms)
+{
+    if (!row || width < AXON_LATENCY_CELLS * 3)
+        return false;
+
+    int level[AXON_LATENCY_CELLS];
+    int lo = 255, hi = 0;
+    for (int c = 0; c < AXON_LATENCY_CELLS; c++) {
+        int x    = (2 * c + 1) * width / (2 * AXON_LATENCY_CELLS);
+        level[c] = (row[x - 1] + row[x] + row[x + 1]) / 3;
+        if (level[c] < lo)
+            lo = level[c];
+        if (level[c] > hi)
+            hi = level[c];
+    }
+    if (hi - lo < LATENCY_MIN_CONTRAST)
+        return false;
+
+    int  threshold = (hi + lo) / 2;
+    bool cells[AXON_LATENCY_CELLS];
+    for (int c = 0; c < AXON_LATENCY_CELLS; c++)
+        cells[c] = level[c] > threshold;
+
+    if (!cells[0] || cells[1] || cells[AXON_LATENCY_CELLS - 2] || !cells[AXON_LATENCY_CELLS - 1])
+        return false;
+
+    uint32_t gray   = 0;
+    bool     parity = false;
+    for (int i = 0; i < AXON_LATENCY_BITS; i++) {
+        gray = (gray << 1) | (cells[2 + i] ? 1u : 0u);
+        parity ^= cells[2 + i];
+    }
+    if (parity != cells[2 + AXON_LATENCY_BITS])
+        return false;
+
+    uint32_t bin = gray;
+    for (uint32_t shift = gray >> 1; shift; shift >>= 1)
+        bin ^= shift;
+    *time_ms = bin & LATENCY_MASK;
+    return true;
+}
+
+void axon_latency_inject(uint8_t* y_plane, int width, int height, int y_stride, int row,
+                         int band_height, uint32_t time_ms)
+{
+    bool cells[AXON_LATENCY_CELLS];
+    axon_latency_encode(time_ms, cells);
+
+    int top    = row - band_height / 2;
+    int bottom = top + band_height;
+    if (top < 0)
+        top = 0;
+    if (bottom > height)
+        bottom = height;
+
+    for (int y = top; y < bottom; y++) {
+        uint8_t* line = y_plane + (size_t) y * y_stride;
+        for (int c = 0; c < AXON_LATENCY_CELLS; c++) {
+            int x0 = c * width / AXON_LATENCY_CELLS;
+            int x1 = (c + 1) * width / AXON_LATENCY_CELLS;
+            memset(line + x0, cells[c] ? 235 : 16, (size_t) (x1 - x0));
+        }
+    }
+}
+
+int axon_latency_elapsed_ms(uint32_t time_ms, uint32_t now_ms)
+{
+    uint32_t diff = (now_ms - time_ms) & LATENCY_MASK;
+    return diff <= LATENCY_MAX_MS ? (int) diff : -1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* latency pattern source                                                    */
+
+struct latency_pattern {
+    obs_source_t* source;
+    uint32_t      width;
+    uint32_t      height;
+};
+
+static const char* pattern_get_name(void* unused)
+{
+    (void) unused;
+    return "Axon Latency Pattern";
+}
+
+static void pattern_update(void* data, obs_data_t* settings)
+{
+    struct latency_pattern* p = (struct latency_pattern*) data;
+    p->width                  = (uint32_t) obs_data_get_int(settings, "width");
+    p->height                 = (uint32_t) obs_data_get_int(settings, "height");
+}
+
+static void* pattern_create(obs_data_t* settings, obs_source_t* source)
+{
+    struct latency_pattern* p = (struct latency_pattern*) bzalloc(sizeof(*p));
+    p->source                 = source;
+    pattern_update(p, settings);
+    return p;
+}
+
+static void pattern_destroy(void* data)
+{
+    bfree(data);
+}
+
+static uint32_t pattern_width(void* data)
+{
+    return ((struct latency_pattern*) data)->width;
+}
+
+static uint32_t pattern_height(void* data)
+{
+    return ((struct latency_pattern*) data)->height;
+}
+
+static void draw_rect(gs_eparam_t* color, float x, float w, float h, const struct vec4* rgba)
+{
+    gs_effect_set_vec4(color, rgba);
+    gs_matrix_push();
+    gs_matrix_translate3f(x, 0.0f, 0.0f);
+    gs_draw_sprite(NULL, 0, (uint32_t) w, (uint32_t) h);
+    gs_matrix_pop();
+}
+
+/* stamped at render time so the code is as fresh as the frame that shows it */
+static void pattern_render(void* data, gs_effect_t* effect)
+{
+    (void) effect;
+    struct latency_pattern* p = (struct latency_pattern*) data;
+
+    bool cells[AXON_LATENCY_CELLS];
+    axon_latency_encode(axon_latency_time_ms(os_gettime_ns()), cells);
+
+    gs_effect_t* solid = obs_get_base_effect(OBS_EFFECT_SOLID);
+    gs_eparam_t* color = gs_effect_get_param_by_name(solid, "color");
+    struct vec4  black = {0.0f, 0.0f, 0.0f, 1.0f};
+    struct vec4  white = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    while (gs_effect_loop(solid, "Solid")) {
+        draw_rect(color, 0.0f, (float) p->width, (float) p->height, &black);
+        for (int c = 0; c < AXON_LATENCY_CELLS; c++) {
+            if (!cells[c])
+                continue;
+            float x0 = (float) (c * p->width / AXON_LATENCY_CELLS);
+            float x1 = (float) ((c + 1) * p->width / AXON_LATENCY_CELLS);
+            draw_rect(color, x0, x1 - x0, (float) p->height, &white);
+        }
+    }
+}
+
+static void pattern_get_defaults(obs_data_t* settings)
+{
+    obs_data_set_default_int(settings, "width", 1280);
+    obs_data_set_default_int(settings, "height", 160);
+}
+
+static obs_properties_t* pattern_get_properties(void* unused)
+{
+    (void) unused;
+    obs_properties_t* props = obs_properties_create();
+    obs_properties_add_int(props, "width", "Width", AXON_LATENCY_CELLS * 4, 7680, 1);
+    obs_properties_add_int(props, "height", "Height", 8, 4320, 1);
+    return props;
+}
+
+struct obs_source_info axon_latency_pattern_info = {
+    .id             = "axon_latency_pattern",
+    .type           = OBS_SOURCE_TYPE_INPUT,
+    .output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+    .get_name       = pattern_get_name,
+    .create         = pattern_create,
+    .destroy        = pattern_destroy,
+    .get_width      = pattern_width,
+    .get_height     = pattern_height,
+    .get_defaults   = pattern_get_defaults,
+    .get_properties = pattern_get_properties,
+    .update         = pattern_update,
+    .video_render   = pattern_render,
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <obs-module.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Glass-to-glass latency timecode.
+ *
+ * The "latency pattern" source draws a horizontal strip of black/white
+ * cells encoding the current monotonic time in milliseconds (24 bits, Gray
+ * coded so a capture taken mid-refresh is off by at most one step). A
+ * capture source pointed at a monitor showing the strip decodes it from
+ * the Y plane and compares it with the clock. For headless runs the capture
+ * side can instead inject the strip itself, stamped with the driver
+ * timestamp, to measure the internal pipeline alone.
+ *
+ * Cell layout: 1 0 | 24 data bits, MSB first | even parity | 0 1
+ */
+
+#define AXON_LATENCY_CELLS 30
+#define AXON_LATENCY_BITS 24
+
+extern struct obs_source_info axon_latency_pattern_info;
+
+uint32_t axon_latency_time_ms(uint64_t ns);
+void     axon_latency_encode(uint32_t time_ms, bool cells[AXON_LATENCY_CELLS]);
+
+/* row is the luma row to sample; false if no valid pattern was found */
+bool axon_latency_decode(const uint8_t* row, int width, uint32_t* time_ms);
+
+/* paint the strip into band_height rows of a luma plane centred on row */
+void axon_latency_inject(uint8_t* y_plane, int width, int height, int y_stride, int row,
+                         int band_height, uint32_t time_ms);
+
+/* milliseconds from the encoded time to now_ms, or -1 if implausible */
+int axon_latency_elapsed_ms(uint32_t time_ms, uint32_t now_ms);
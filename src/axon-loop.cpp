@@ -0,0 +1,569 @@
+#include "axon-loop.h"
+
+#include <obs-module.h>
+#include <util/threading.h>
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define AXON_LOOP_MAX_WATCHES 256
+#define AXON_LOOP_RING_ENTRIES 1024
+#define AXON_LOOP_WAKE_TOKEN (~0ULL)
+
+struct axon_watch {
+    int          fd;
+    uint32_t     events;
+    axon_loop_cb cb;
+    void*        data;
+
+    /* bumped every time the slot is reused so stale completions are ignored */
+    uint32_t gen;
+    bool     used;
+    bool     active;
+
+    /* owner asked for no more events but still holds the slot */
+    bool paused;
+
+    /* io_uring only: a one-shot POLL_ADD is outstanding for this slot */
+    bool armed;
+};
+
+struct uring {
+    int fd;
+
+    void*               sq_ptr;
+    size_t              sq_size;
+    void*               cq_ptr;
+    size_t              cq_size;
+    struct io_uring_sqe* sqes;
+    size_t              sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned  sq_entries;
+    unsigned  to_submit;
+
+    unsigned*            cq_head;
+    unsigned*            cq_tail;
+    unsigned*            cq_mask;
+    struct io_uring_cqe* cqes;
+};
+
+static struct {
+    bool          initialized;
+    volatile bool stop;
+    pthread_t     thread;
+
+    int  wake_fd;
+    bool wake_armed;
+
+    bool        use_uring;
+    struct uring ring;
+    int         epoll_fd;
+
+    /* guards watches[] and dispatching */
+    pthread_mutex_t   lock;
+    pthread_cond_t    cond;
+    struct axon_watch watches[AXON_LOOP_MAX_WATCHES];
+    int               dispatching;
+} loop;
+
+static __thread bool on_loop_thread = false;
+
+static inline uint64_t watch_token(const struct axon_watch* w)
+{
+    return ((uint64_t) w->gen << 32) | (uint64_t) (w - loop.watches);
+}
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_destroy(struct uring* r)
+{
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr)
+        munmap(r->cq_ptr, r->cq_size);
+    if (r->sq_ptr)
+        munmap(r->sq_ptr, r->sq_size);
+    if (r->fd >= 0)
+        close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+static bool uring_create(struct uring* r)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = sys_io_uring_setup(AXON_LOOP_RING_ENTRIES, &p);
+    if (r->fd < 0) {
+        r->fd = -1;
+        return false;
+    }
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && r->cq_size > r->sq_size)
+        r->sq_size = r->cq_size;
+
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+                     IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        uring_destroy(r);
+        return false;
+    }
+
+    if (single_mmap) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            r->cq_ptr = NULL;
+            uring_destroy(r);
+            return false;
+        }
+    }
+
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe*) mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        uring_destroy(r);
+        return false;
+    }
+
+    uint8_t* sq    = (uint8_t*) r->sq_ptr;
+    uint8_t* cq    = (uint8_t*) r->cq_ptr;
+    r->sq_head     = (unsigned*) (sq + p.sq_off.head);
+    r->sq_tail     = (unsigned*) (sq + p.sq_off.tail);
+    r->sq_mask     = (unsigned*) (sq + p.sq_off.ring_mask);
+    r->sq_array    = (unsigned*) (sq + p.sq_off.array);
+    r->sq_entries  = p.sq_entries;
+    r->cq_head     = (unsigned*) (cq + p.cq_off.head);
+    r->cq_tail     = (unsigned*) (cq + p.cq_off.tail);
+    r->cq_mask     = (unsigned*) (cq + p.cq_off.ring_mask);
+    r->cqes        = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+    r->to_submit   = 0;
+    return true;
+}
+
+static void uring_flush(struct uring* r)
+{
+    while (r->to_submit > 0) {
+        int ret = sys_io_uring_enter(r->fd, r->to_submit, 0, 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            blog(LOG_ERROR, "[axon] io_uring_enter submit failed: %s", strerror(errno));
+            r->to_submit = 0;
+            return;
+        }
+        r->to_submit -= (unsigned) ret < r->to_submit ? (unsigned) ret : r->to_submit;
+    }
+}
+
+static struct io_uring_sqe* uring_get_sqe(struct uring* r)
+{
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *r->sq_tail;
+    if (tail - head >= r->sq_entries) {
+        uring_flush(r);
+        head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= r->sq_entries)
+            return NULL;
+    }
+
+    unsigned             index = tail & *r->sq_mask;
+    struct io_uring_sqe* sqe   = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->to_submit++;
+    return sqe;
+}
+
+static bool uring_poll_add(struct uring* r, int fd, uint32_t events, uint64_t token)
+{
+    struct io_uring_sqe* sqe = uring_get_sqe(r);
+    if (!sqe)
+        return false;
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = fd;
+    sqe->poll32_events = events;
+    sqe->user_data     = token;
+    return true;
+}
+
+static void uring_poll_remove(struct uring* r, uint64_t token)
+{
+    struct io_uring_sqe* sqe = uring_get_sqe(r);
+    if (!sqe)
+        return;
+    sqe->opcode    = IORING_OP_POLL_REMOVE;
+    sqe->fd        = -1;
+    sqe->addr      = token;
+    sqe->user_data = AXON_LOOP_WAKE_TOKEN - 1;
+}
+
+static void wake_loop(void)
+{
+    uint64_t one = 1;
+    ssize_t  ret = write(loop.wake_fd, &one, sizeof(one));
+    (void) ret;
+}
+
+static void drain_wake(void)
+{
+    uint64_t val;
+    ssize_t  ret = read(loop.wake_fd, &val, sizeof(val));
+    (void) ret;
+}
+
+/* loop thread, lock held: arm new watches, cancel removed ones */
+static void uring_sync_watches(void)
+{
+    if (!loop.wake_armed) {
+        loop.wake_armed = uring_poll_add(&loop.ring, loop.wake_fd, POLLIN, AXON_LOOP_WAKE_TOKEN);
+    }
+
+    bool freed = false;
+    for (int i = 0; i < AXON_LOOP_MAX_WATCHES; i++) {
+        struct axon_watch* w = &loop.watches[i];
+        if (!w->used || loop.dispatching == i)
+            continue;
+
+        if (w->active && !w->paused && !w->armed) {
+            w->armed = uring_poll_add(&loop.ring, w->fd, w->events, watch_token(w));
+        } else if (w->active && w->paused && w->armed) {
+            uring_poll_remove(&loop.ring, watch_token(w));
+            w->armed = false;
+        } else if (!w->active) {
+            if (w->armed)
+                uring_poll_remove(&loop.ring, watch_token(w));
+            w->armed = false;
+            w->used  = false;
+            w->gen++;
+            freed = true;
+        }
+    }
+
+    if (freed)
+        pthread_cond_broadcast(&loop.cond);
+}
+
+static void dispatch(uint64_t token, uint32_t revents)
+{
+    uint32_t idx = (uint32_t) (token & 0xffffffffu);
+    uint32_t gen = (uint32_t) (token >> 32);
+    if (idx >= AXON_LOOP_MAX_WATCHES)
+        return;
+
+    pthread_mutex_lock(&loop.lock);
+    struct axon_watch* w = &loop.watches[idx];
+    if (loop.use_uring && w->used && w->gen == gen)
+        w->armed = false;
+    if (!w->used || !w->active || w->paused || w->gen != gen) {
+        pthread_mutex_unlock(&loop.lock);
+        return;
+    }
+    loop.dispatching = (int) idx;
+    axon_loop_cb cb  = w->cb;
+    void*        arg = w->data;
+    pthread_mutex_unlock(&loop.lock);
+
+    cb(arg, revents);
+
+    pthread_mutex_lock(&loop.lock);
+    loop.dispatching = -1;
+    if (!loop.use_uring && !w->active && w->used) {
+        w->used = false;
+        w->gen++;
+    }
+    pthread_cond_broadcast(&loop.cond);
+    pthread_mutex_unlock(&loop.lock);
+}
+
+static void run_uring(void)
+{
+    struct uring* r = &loop.ring;
+
+    while (!loop.stop) {
+        pthread_mutex_lock(&loop.lock);
+        uring_sync_watches();
+        pthread_mutex_unlock(&loop.lock);
+
+        int ret = sys_io_uring_enter(r->fd, r->to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            blog(LOG_ERROR, "[axon] io_uring_enter failed: %s", strerror(errno));
+            break;
+        }
+        r->to_submit -= (unsigned) ret < r->to_submit ? (unsigned) ret : r->to_submit;
+
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+            uint64_t             tok = cqe->user_data;
+            int32_t              res = cqe->res;
+            head++;
+            __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+            if (tok == AXON_LOOP_WAKE_TOKEN) {
+                drain_wake();
+                loop.wake_armed = false;
+            } else if (tok != AXON_LOOP_WAKE_TOKEN - 1) {
+                /* -ECANCELED for removed watches is filtered by the generation */
+                dispatch(tok, res < 0 ? (uint32_t) POLLERR : (uint32_t) res);
+            }
+            tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        }
+    }
+}
+
+static void run_epoll(void)
+{
+    struct epoll_event events[64];
+
+    while (!loop.stop) {
+        int n = epoll_wait(loop.epoll_fd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            blog(LOG_ERROR, "[axon] epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u64 == AXON_LOOP_WAKE_TOKEN) {
+                drain_wake();
+                continue;
+            }
+            dispatch(events[i].data.u64, events[i].events);
+        }
+    }
+}
+
+static void* loop_thread_fn(void* arg)
+{
+    (void) arg;
+    os_set_thread_name("axon-loop");
+    on_loop_thread = true;
+
+    if (loop.use_uring)
+        run_uring();
+    else
+        run_epoll();
+    return NULL;
+}
+
+bool axon_loop_init(void)
+{
+    if (loop.initialized)
+        return true;
+
+    memset(&loop, 0, sizeof(loop));
+    loop.dispatching = -1;
+    loop.epoll_fd    = -1;
+    loop.ring.fd     = -1;
+
+    loop.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop.wake_fd < 0) {
+        blog(LOG_ERROR, "[axon] eventfd failed: %s", strerror(errno));
+        return false;
+    }
+
+    loop.use_uring = uring_create(&loop.ring);
+    if (!loop.use_uring) {
+        loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop.epoll_fd < 0) {
+            blog(LOG_ERROR, "[axon] epoll_create1 failed: %s", strerror(errno));
+            close(loop.wake_fd);
+            return false;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events   = EPOLLIN;
+        ev.data.u64 = AXON_LOOP_WAKE_TOKEN;
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, loop.wake_fd, &ev);
+    }
+
+    pthread_mutex_init(&loop.lock, NULL);
+    pthread_cond_init(&loop.cond, NULL);
+
+    loop.stop = false;
+    if (pthread_create(&loop.thread, NULL, loop_thread_fn, NULL) != 0) {
+        blog(LOG_ERROR, "[axon] Failed to start event loop thread");
+        if (loop.use_uring)
+            uring_destroy(&loop.ring);
+        else
+            close(loop.epoll_fd);
+        close(loop.wake_fd);
+        pthread_cond_destroy(&loop.cond);
+        pthread_mutex_destroy(&loop.lock);
+        return false;
+    }
+
+    loop.initialized = true;
+    blog(LOG_INFO, "[axon] Event loop started (%s)", loop.use_uring ? "io_uring" : "epoll");
+    return true;
+}
+
+void axon_loop_shutdown(void)
+{
+    if (!loop.initialized)
+        return;
+
+    loop.stop = true;
+    wake_loop();
+    pthread_join(loop.thread, NULL);
+
+    if (loop.use_uring)
+        uring_destroy(&loop.ring);
+    else
+        close(loop.epoll_fd);
+    close(loop.wake_fd);
+
+    pthread_cond_destroy(&loop.cond);
+    pthread_mutex_destroy(&loop.lock);
+    loop.initialized = false;
+}
+
+struct axon_watch* axon_loop_add(int fd, uint32_t events, axon_loop_cb cb, void* data)
+{
+    if (!loop.initialized || fd < 0 || !cb)
+        return NULL;
+
+    pthread_mutex_lock(&loop.lock);
+
+    struct axon_watch* w = NULL;
+    for (int i = 0; i < AXON_LOOP_MAX_WATCHES; i++) {
+        if (!loop.watches[i].used) {
+            w = &loop.watches[i];
+            break;
+        }
+    }
+    if (!w) {
+        pthread_mutex_unlock(&loop.lock);
+        blog(LOG_ERROR, "[axon] Event loop watch table full");
+        return NULL;
+    }
+
+    w->fd     = fd;
+    w->events = events;
+    w->cb     = cb;
+    w->data   = data;
+    w->used   = true;
+    w->active = true;
+    w->paused = false;
+    w->armed  = false;
+
+    if (!loop.use_uring) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events   = events;
+        ev.data.u64 = watch_token(w);
+        if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            blog(LOG_ERROR, "[axon] epoll_ctl add fd=%d failed: %s", fd, strerror(errno));
+            w->used   = false;
+            w->active = false;
+            w->gen++;
+            pthread_mutex_unlock(&loop.lock);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&loop.lock);
+
+    if (loop.use_uring)
+        wake_loop();
+    return w;
+}
+
+void axon_loop_remove(struct axon_watch* w)
+{
+    if (!w || !loop.initialized)
+        return;
+
+    int idx = (int) (w - loop.watches);
+
+    pthread_mutex_lock(&loop.lock);
+    if (!w->used || !w->active) {
+        pthread_mutex_unlock(&loop.lock);
+        return;
+    }
+    w->active = false;
+
+    if (!loop.use_uring && !w->paused)
+        epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, w->fd, NULL);
+
+    if (on_loop_thread) {
+        /* removing from a callback: the loop frees the slot after dispatch */
+        if (!loop.use_uring && loop.dispatching != idx) {
+            w->used = false;
+            w->gen++;
+        }
+        pthread_mutex_unlock(&loop.lock);
+        return;
+    }
+
+    if (loop.use_uring) {
+        wake_loop();
+        while (w->used)
+            pthread_cond_wait(&loop.cond, &loop.lock);
+    } else {
+        while (loop.dispatching == idx)
+            pthread_cond_wait(&loop.cond, &loop.lock);
+        if (w->used) {
+            w->used = false;
+            w->gen++;
+        }
+    }
+    pthread_mutex_unlock(&loop.lock);
+}
+
+void axon_loop_pause(struct axon_watch* w)
+{
+    if (!w || !loop.initialized)
+        return;
+
+    pthread_mutex_lock(&loop.lock);
+    if (w->used && w->active && !w->paused) {
+        w->paused = true;
+        if (!loop.use_uring)
+            epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, w->fd, NULL);
+    }
+    pthread_mutex_unlock(&loop.lock);
+
+    if (loop.use_uring && !on_loop_thread)
+        wake_loop();
+}
+
+bool axon_loop_on_loop_thread(void)
+{
+    return on_loop_thread;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Process-wide event loop shared by every capture source.
+ *
+ * One thread waits on all registered fds (V4L2 capture nodes, ALSA poll
+ * descriptors) through io_uring poll requests, falling back to epoll when
+ * io_uring is unavailable. Callbacks run on the loop thread and must not
+ * block; heavy work belongs in the worker pool (axon-pool.h).
+ */
+
+typedef void (*axon_loop_cb)(void* data, uint32_t revents);
+
+struct axon_watch;
+
+bool axon_loop_init(void);
+void axon_loop_shutdown(void);
+
+/* events/revents use poll(2) bits (POLLIN, POLLOUT, POLLERR, ...) */
+struct axon_watch* axon_loop_add(int fd, uint32_t events, axon_loop_cb cb, void* data);
+
+/* once this returns the callback is not running and will not run again */
+void axon_loop_remove(struct axon_watch* w);
+
+/* stop delivering events but keep the slot; still call axon_loop_remove() */
+void axon_loop_pause(struct axon_watch* w);
+
+bool axon_loop_on_loop_thread(void);
@@ -0,0 +1,354 @@
+#include "axon-lut.h"
+
+#include <obs-module.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* AXON_LUT_PORTABLE builds only the portable blend, for the self-test to compare against */
+#if defined(__SSE2__) && !defined(AXON_LUT_PORTABLE)
+#define LUT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(AXON_LUT_PORTABLE)
+#define LUT_NEON
+#include <arm_neon.h>
+#endif
+
+#define LUT_MAX_SIZE 65
+
+/* node values are 8.8 fixed point, so the interpolated result shifts straight to 8 bits */
+#define LUT_ONE (255 << 8)
+
+#define AXIS_WEIGHT_BITS 9
+#define AXIS_WEIGHT_MASK ((1u << AXIS_WEIGHT_BITS) - 1)
+
+/* in BGRA order, so a blended node is already in output byte order */
+struct lut_node {
+    uint16_t b, g, r, pad;
+};
+
+struct axon_lut {
+    struct axon_lut* next;
+    int              refs;
+    char             path[512];
+    time_t           mtime;
+
+    int size;
+
+    /*
+     * per channel (r, g, b) and 8-bit input: node offset of the grid cell
+     * shifted up by AXIS_WEIGHT_BITS, ored with the weight (0..256)
+     */
+    uint32_t axis[3][256];
+
+    /* tetrahedron corners, indexed by the weight comparisons, and the far corner */
+    int32_t corner_a[8];
+    int32_t corner_b[8];
+    int32_t diagonal;
+
+    struct lut_node* nodes; /* red fastest, then green, then blue */
+};
+
+static struct {
+    pthread_mutex_t  lock;
+    struct axon_lut* list;
+} luts = {PTHREAD_MUTEX_INITIALIZER, NULL};
+
+static uint16_t to_fixed(double v)
+{
+    if (v < 0.0)
+        v = 0.0;
+    if (v > 1.0)
+        v = 1.0;
+    return (uint16_t) (v * LUT_ONE + 0.5);
+}
+
+static void build_axis(struct axon_lut* lut, int channel, double lo, double hi)
+{
+    int    last   = lut->size - 1;
+    double range  = hi > lo ? hi - lo : 1.0;
+    int    stride = channel == 0 ? 1 : (channel == 1 ? lut->size : lut->size * lut->size);
+
+    for (int v = 0; v < 256; v++) {
+        double pos = ((double) v / 255.0 - lo) / range * last;
+        if (pos < 0.0)
+            pos = 0.0;
+        if (pos > last)
+            pos = last;
+
+        int cell = (int) pos;
+        if (cell >= last)
+            cell = last - 1;
+        uint32_t weight       = (uint32_t) ((pos - cell) * 256.0 + 0.5);
+        lut->axis[channel][v] = (uint32_t) (cell * stride) << AXIS_WEIGHT_BITS | weight;
+    }
+}
+
+/*
+ * Tetrahedral interpolation splits each cell into six tetrahedra along the
+ * c000-c111 diagonal; the order of the r/g/b weights picks one, and the walk
+ * goes c000 -> a -> b -> c111, stepping along the axis with the largest
+ * weight first. Index bits: r > g, g > b, r > b. Two combinations cannot
+ * happen and reuse a neighbour; ties give the shared face either way.
+ */
+static void build_tetrahedra(struct axon_lut* lut)
+{
+    const int32_t r = 1, g = lut->size, b = lut->size * lut->size;
+    const int32_t a_off[8] = {b, b, g, g, b, r, r, r};
+    const int32_t b_off[8] = {g + b, g + b, g + b, r + g, r + b, r + b, r + g, r + g};
+
+    memcpy(lut->corner_a, a_off, sizeof(a_off));
+    lut->diagonal = r + g + b;
+    memcpy(lut->corner_b, b_off, sizeof(b_off));
+}
+
+static struct axon_lut* load_cube(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        blog(LOG_WARNING, "[axon] Cannot open LUT %s", path);
+        return NULL;
+    }
+
+    struct axon_lut* lut = (struct axon_lut*) bzalloc(sizeof(*lut));
+    double           lo[3] = {0.0, 0.0, 0.0};
+    double           hi[3] = {1.0, 1.0, 1.0};
+    int              count = 0;
+    int              total = 0;
+    bool             ok    = true;
+    char             line[256];
+
+    while (ok && fgets(line, sizeof(line), f)) {
+        char* p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\r' || !*p || !strncmp(p, "TITLE", 5))
+            continue;
+
+        double r, g, b;
+        if (!strncmp(p, "LUT_3D_SIZE", 11)) {
+            lut->size = atoi(p + 11);
+            if (lut->size < 2 || lut->size > LUT_MAX_SIZE || lut->nodes) {
+                ok = false;
+                break;
+            }
+            total      = lut->size * lut->size * lut->size;
+            lut->nodes = (struct lut_node*) bzalloc(sizeof(*lut->nodes) * total);
+        } else if (!strncmp(p, "LUT_1D_SIZE", 11)) {
+            ok = false;
+        } else if (sscanf(p, "DOMAIN_MIN %lf %lf %lf", &lo[0], &lo[1], &lo[2]) == 3 ||
+                   sscanf(p, "DOMAIN_MAX %lf %lf %lf", &hi[0], &hi[1], &hi[2]) == 3) {
+            continue;
+        } else if (sscanf(p, "LUT_3D_INPUT_RANGE %lf %lf", &r, &g) == 2) {
+            lo[0] = lo[1] = lo[2] = r;
+            hi[0] = hi[1] = hi[2] = g;
+        } else if (sscanf(p, "%lf %lf %lf", &r, &g, &b) == 3) {
+            if (!lut->nodes || count >= total) {
+                ok = false;
+                break;
+            }
+            lut->nodes[count].r = to_fixed(r);
+            lut->nodes[count].g = to_fixed(g);
+            lut->nodes[count].b = to_fixed(b);
+            count++;
+        }
+    }
+    fclose(f);
+
+    if (!ok || !lut->nodes || count != total) {
+        blog(LOG_WARNING, "[axon] %s is not a usable 3D .cube LUT", path);
+        bfree(lut->nodes);
+        bfree(lut);
+        return NULL;
+    }
+
+    for (int c = 0; c < 3; c++)
+        build_axis(lut, c, lo[c], hi[c]);
+    build_tetrahedra(lut);
+    blog(LOG_INFO, "[axon] Loaded %d^3 LUT %s", lut->size, path);
+    return lut;
+}
+
+struct axon_lut* axon_lut_acquire(const char* path)
+{
+    struct stat st;
+    if (!path || !path[0] || stat(path, &st) < 0)
+        return NULL;
+
+    pthread_mutex_lock(&luts.lock);
+    for (struct axon_lut* lut = luts.list; lut; lut = lut->next) {
+        if (!strcmp(lut->path, path) && lut->mtime == st.st_mtime) {
+            lut->refs++;
+            pthread_mutex_unlock(&luts.lock);
+            return lut;
+        }
+    }
+    pthread_mutex_unlock(&luts.lock);
+
+    /* parse outside the lock; a racing load of the same file just wastes one */
+    struct axon_lut* lut = load_cube(path);
+    if (!lut)
+        return NULL;
+    snprintf(lut->path, sizeof(lut->path), "%s", path);
+    lut->mtime = st.st_mtime;
+    lut->refs  = 1;
+
+    pthread_mutex_lock(&luts.lock);
+    lut->next = luts.list;
+    luts.list = lut;
+    pthread_mutex_unlock(&luts.lock);
+    return lut;
+}
+
+void axon_lut_release(struct axon_lut* lut)
+{
+    if (!lut)
+        return;
+
+    pthread_mutex_lock(&luts.lock);
+    bool last = --lut->refs == 0;
+    if (last) {
+        for (struct axon_lut** p = &luts.list; *p; p = &(*p)->next) {
+            if (*p == lut) {
+                *p = lut->next;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&luts.lock);
+
+    if (last) {
+        bfree(lut->nodes);
+        bfree(lut);
+    }
+}
+
+/*
+ * The cell corners of one pixel and their weights over 256:
+ * out = k[0] c000 + k[1] a + k[2] b + k[3] c111. The weights are all
+ * non-negative and sum to 256, and are the sorted axis weights w0 >= w1 >= w2
+ * as differences: 256 - w0, w0 - w1, w1 - w2, w2.
+ */
+struct lut_cell {
+    const struct lut_node* c[4];
+    int                    k[4];
+};
+
+/* px is one BGRA pixel as loaded from memory (little endian) */
+static inline void find_cell(const struct axon_lut* lut, uint32_t px, struct lut_cell* cell)
+{
+    uint32_t ar = lut->axis[0][(px >> 16) & 0xff];
+    uint32_t ag = lut->axis[1][(px >> 8) & 0xff];
+    uint32_t ab = lut->axis[2][px & 0xff];
+    int      wr = (int) (ar & AXIS_WEIGHT_MASK);
+    int      wg = (int) (ag & AXIS_WEIGHT_MASK);
+    int      wb = (int) (ab & AXIS_WEIGHT_MASK);
+    int      t  = (wr > wg) << 2 | (wg > wb) << 1 | (wr > wb);
+
+    /* sorted with min/max rather than an index table, so the compiler keeps it in registers */
+    int hi = wr > wg ? wr : wg;
+    int lo = wr > wg ? wg : wr;
+    int w0 = hi > wb ? hi : wb;
+    int w2 = lo < wb ? lo : wb;
+    int w1 = wr + wg + wb - w0 - w2;
+
+    const struct lut_node* c000 = lut->nodes + (ar >> AXIS_WEIGHT_BITS) +
+                                  (ag >> AXIS_WEIGHT_BITS) + (ab >> AXIS_WEIGHT_BITS);
+    cell->c[0] = c000;
+    cell->c[1] = c000 + lut->corner_a[t];
+    cell->c[2] = c000 + lut->corner_b[t];
+    cell->c[3] = c000 + lut->diagonal;
+    cell->k[0] = 256 - w0;
+    cell->k[1] = w0 - w1;
+    cell->k[2] = w1 - w2;
+    cell->k[3] = w2;
+}
+/*
+ * The blend is the same integer sum on every path, so all three give
+ * identical output: the node values are 8.8 and the weights over 256, and
+ * (sum + 2^15) >> 16 is the rounded 8-bit result.
+ */
+#if defined(LUT_SSE2)
+
+/* madd works on signed 16-bit pairs, so nodes are biased by 2^15; the weights sum to 256 */
+#define LUT_BIAS (32768 * 256 + 32768)
+
+void axon_lut_apply(const struct axon_lut* lut, uint8_t* bgra, int n)
+{
+    const __m128i flip = _mm_set1_epi16((short) 0x8000);
+    const __m128i bias = _mm_set1_epi32(LUT_BIAS);
+
+    for (int i = 0; i < n; i++, bgra += 4) {
+        uint32_t        px;
+        struct lut_cell cell;
+        memcpy(&px, bgra, 4);
+        find_cell(lut, px, &cell);
+
+        __m128i c0 = _mm_loadl_epi64((const __m128i*) cell.c[0]);
+        __m128i c1 = _mm_loadl_epi64((const __m128i*) cell.c[1]);
+        __m128i c2 = _mm_loadl_epi64((const __m128i*) cell.c[2]);
+        __m128i c3 = _mm_loadl_epi64((const __m128i*) cell.c[3]);
+
+        /* (c000, a) and (b, c111) pairs per channel, each against its pair of weights */
+        __m128i p01 = _mm_xor_si128(_mm_unpacklo_epi16(c0, c1), flip);
+        __m128i p23 = _mm_xor_si128(_mm_unpacklo_epi16(c2, c3), flip);
+        __m128i k01 = _mm_set1_epi32(cell.k[0] | cell.k[1] << 16);
+        __m128i k23 = _mm_set1_epi32(cell.k[2] | cell.k[3] << 16);
+        __m128i sum = _mm_add_epi32(_mm_madd_epi16(p01, k01), _mm_madd_epi16(p23, k23));
+
+        __m128i v = _mm_srai_epi32(_mm_add_epi32(sum, bias), 16);
+        v         = _mm_packs_epi32(v, v);
+        v         = _mm_packus_epi16(v, v);
+
+        /* the pad lane blends to 0; alpha is kept from the input */
+        px = (px & 0xff000000u) | (uint32_t) _mm_cvtsi128_si32(v);
+        memcpy(bgra, &px, 4);
+    }
+}
+
+#elif defined(LUT_NEON)
+
+void axon_lut_apply(const struct axon_lut* lut, uint8_t* bgra, int n)
+{
+    for (int i = 0; i < n; i++, bgra += 4) {
+        uint32_t        px;
+        struct lut_cell cell;
+        memcpy(&px, bgra, 4);
+        find_cell(lut, px, &cell);
+
+        uint32x4_t sum = vmull_n_u16(vld1_u16(&cell.c[0]->b), (uint16_t) cell.k[0]);
+        sum            = vmlal_n_u16(sum, vld1_u16(&cell.c[1]->b), (uint16_t) cell.k[1]);
+        sum            = vmlal_n_u16(sum, vld1_u16(&cell.c[2]->b), (uint16_t) cell.k[2]);
+        sum            = vmlal_n_u16(sum, vld1_u16(&cell.c[3]->b), (uint16_t) cell.k[3]);
+        uint8x8_t v    = vmovn_u16(vcombine_u16(vrshrn_n_u32(sum, 16), vdup_n_u16(0)));
+
+        /* the pad lane blends to 0; alpha is kept from the input */
+        px = (px & 0xff000000u) | vget_lane_u32(vreinterpret_u32_u8(v), 0);
+        memcpy(bgra, &px, 4);
+    }
+}
+
+#else
+
+void axon_lut_apply(const struct axon_lut* lut, uint8_t* bgra, int n)
+{
+    for (int i = 0; i < n; i++, bgra += 4) {
+        uint32_t        px;
+        struct lut_cell cell;
+        memcpy(&px, bgra, 4);
+        find_cell(lut, px, &cell);
+
+        const struct lut_node* const* c = cell.c;
+        const int*                    k = cell.k;
+
+        uint32_t out_b = k[0] * c[0]->b + k[1] * c[1]->b + k[2] * c[2]->b + k[3] * c[3]->b;
+        uint32_t out_g = k[0] * c[0]->g + k[1] * c[1]->g + k[2] * c[2]->g + k[3] * c[3]->g;
+        uint32_t out_r = k[0] * c[0]->r + k[1] * c[1]->r + k[2] * c[2]->r + k[3] * c[3]->r;
+
+        px = (px & 0xff000000u) | ((out_r + 32768) >> 16) << 16 | ((out_g + 32768) >> 16) << 8 |
+             (out_b + 32768) >> 16;
+        memcpy(bgra, &px, 4);
+    }
+}
+
+#endif
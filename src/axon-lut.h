@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * 3D colour LUTs from .cube files (Resolve/Adobe format, LUT_3D_SIZE up to
+ * 65), applied with tetrahedral interpolation on 8-bit BGRA. Nodes are
+ * stored as 16-bit fixed point, so a 17^3 table is about 40 KB and a 33^3
+ * one under 300 KB, small enough to stay in cache while a stripe is graded.
+ * The corner blend runs on SSE2 or NEON where available, with the same
+ * integer result as the portable loop.
+ *
+ * Tables are shared: every source that names the same (unchanged) file gets
+ * the same one, and it is freed when the last of them lets go.
+ */
+
+struct axon_lut;
+
+/* NULL if the file cannot be read or parsed */
+struct axon_lut* axon_lut_acquire(const char* path);
+void             axon_lut_release(struct axon_lut* lut);
+
+/* grade n BGRA pixels in place; alpha is left alone */
+void axon_lut_apply(const struct axon_lut* lut, uint8_t* bgra, int n);
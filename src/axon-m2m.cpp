@@ -0,0 +1,739 @@
+#include "axon-m2m.h"
+#include "axon-loop.h"
+#include "axon-pool.h"
+#include "axon-trace.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define M2M_CAPTURE_BUFFERS 2
+#define ENCODER_CAPTURE_BUFFERS 4
+#define MAX_CAPTURE_BUFFERS 4
+
+/* how long closing an encoder waits for the frames still inside it */
+#define ENCODER_DRAIN_TIMEOUT_MS 2000
+
+struct axon_m2m {
+    int                fd;
+    bool               mplane;
+    enum v4l2_buf_type out_type; /* frames we feed in */
+    enum v4l2_buf_type cap_type; /* converted frames */
+    int                in_planes;
+
+    uint32_t out_fourcc;
+    int      out_width;
+    int      out_height;
+    uint32_t out_stride;
+    void*    cap_map[MAX_CAPTURE_BUFFERS];
+    size_t   cap_len[MAX_CAPTURE_BUFFERS];
+    int      num_cap;
+    int      next_cap;
+};
+
+/* result formats in order of preference; 32-bit BGRA layouts copy straight through */
+static const uint32_t output_formats[] = {
+    V4L2_PIX_FMT_XBGR32, V4L2_PIX_FMT_ABGR32, V4L2_PIX_FMT_BGR32,
+    V4L2_PIX_FMT_BGR24,  V4L2_PIX_FMT_RGB24,
+};
+
+static int xioctl(int fd, unsigned long req, void* arg)
+{
+    int ret;
+    do {
+        ret = ioctl(fd, req, arg);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+static bool set_input_format(struct axon_m2m* m, const struct axon_m2m_format* in)
+{
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = m->out_type;
+
+    if (m->mplane) {
+        fmt.fmt.pix_mp.width       = (uint32_t) in->width;
+        fmt.fmt.pix_mp.height      = (uint32_t) in->height;
+        fmt.fmt.pix_mp.pixelformat = in->fourcc;
+        fmt.fmt.pix_mp.num_planes  = (uint8_t) in->num_planes;
+        for (int p = 0; p < in->num_planes; p++)
+            fmt.fmt.pix_mp.plane_fmt[p].bytesperline = in->bytesperline[p];
+    } else {
+        if (in->num_planes != 1)
+            return false;
+        fmt.fmt.pix.width        = (uint32_t) in->width;
+        fmt.fmt.pix.height       = (uint32_t) in->height;
+        fmt.fmt.pix.pixelformat  = in->fourcc;
+        fmt.fmt.pix.bytesperline = in->bytesperline[0];
+    }
+
+    if (xioctl(m->fd, VIDIOC_S_FMT, &fmt) < 0)
+        return false;
+
+    /* the dmabufs come from the camera as they are, so the layout must match */
+    if (m->mplane) {
+        if (fmt.fmt.pix_mp.pixelformat != in->fourcc ||
+            fmt.fmt.pix_mp.width != (uint32_t) in->width ||
+            fmt.fmt.pix_mp.height != (uint32_t) in->height ||
+            fmt.fmt.pix_mp.num_planes != in->num_planes)
+            return false;
+        for (int p = 0; p < in->num_planes; p++) {
+            if (fmt.fmt.pix_mp.plane_fmt[p].bytesperline != in->bytesperline[p])
+                return false;
+        }
+        return true;
+    }
+    return fmt.fmt.pix.pixelformat == in->fourcc && fmt.fmt.pix.width == (uint32_t) in->width &&
+           fmt.fmt.pix.height == (uint32_t) in->height &&
+           fmt.fmt.pix.bytesperline == in->bytesperline[0];
+}
+
+static bool set_output_format(struct axon_m2m* m, uint32_t fourcc)
+{
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = m->cap_type;
+
+    if (m->mplane) {
+        fmt.fmt.pix_mp.width       = (uint32_t) m->out_width;
+        fmt.fmt.pix_mp.height      = (uint32_t) m->out_height;
+        fmt.fmt.pix_mp.pixelformat = fourcc;
+        fmt.fmt.pix_mp.num_planes  = 1;
+    } else {
+        fmt.fmt.pix.width       = (uint32_t) m->out_width;
+        fmt.fmt.pix.height      = (uint32_t) m->out_height;
+        fmt.fmt.pix.pixelformat = fourcc;
+    }
+
+    if (xioctl(m->fd, VIDIOC_S_FMT, &fmt) < 0)
+        return false;
+
+    uint32_t got    = m->mplane ? fmt.fmt.pix_mp.pixelformat : fmt.fmt.pix.pixelformat;
+    uint32_t width  = m->mplane ? fmt.fmt.pix_mp.width : fmt.fmt.pix.width;
+    uint32_t height = m->mplane ? fmt.fmt.pix_mp.height : fmt.fmt.pix.height;
+    if (got != fourcc || width != (uint32_t) m->out_width || height != (uint32_t) m->out_height)
+        return false;
+
+    m->out_fourcc = fourcc;
+    m->out_stride = m->mplane ? fmt.fmt.pix_mp.plane_fmt[0].bytesperline
+                              : fmt.fmt.pix.bytesperline;
+    return true;
+}
+
+static bool map_capture_buffers(struct axon_m2m* m, int count)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count  = (uint32_t) count;
+    req.type   = m->cap_type;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(m->fd, VIDIOC_REQBUFS, &req) < 0 || req.count == 0)
+        return false;
+    m->num_cap = req.count < MAX_CAPTURE_BUFFERS ? (int) req.count : MAX_CAPTURE_BUFFERS;
+
+    for (int i = 0; i < m->num_cap; i++) {
+        struct v4l2_buffer buf;
+        struct v4l2_plane  planes[VIDEO_MAX_PLANES];
+        memset(&buf, 0, sizeof(buf));
+        memset(planes, 0, sizeof(planes));
+        buf.type   = m->cap_type;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index  = (uint32_t) i;
+        if (m->mplane) {
+            buf.m.planes = planes;
+            buf.length   = VIDEO_MAX_PLANES;
+        }
+        if (xioctl(m->fd, VIDIOC_QUERYBUF, &buf) < 0)
+            return false;
+
+        size_t len = m->mplane ? planes[0].length : buf.length;
+        off_t  off = m->mplane ? planes[0].m.mem_offset : buf.m.offset;
+        void*  map = mmap(NULL, len, PROT_READ, MAP_SHARED, m->fd, off);
+        if (map == MAP_FAILED)
+            return false;
+        m->cap_map[i] = map;
+        m->cap_len[i] = len;
+    }
+    return true;
+}
+
+static bool open_device(struct axon_m2m* m, const char* path)
+{
+    m->fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (m->fd < 0) {
+        blog(LOG_ERROR, "[axon] Failed to open M2M device %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (xioctl(m->fd, VIDIOC_QUERYCAP, &cap) < 0) {
+        close(m->fd);
+        return false;
+    }
+    uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & (V4L2_CAP_VIDEO_M2M_MPLANE | V4L2_CAP_VIDEO_M2M))) {
+        blog(LOG_ERROR, "[axon] %s is not a memory-to-memory device", path);
+        close(m->fd);
+        return false;
+    }
+
+    m->mplane   = (caps & V4L2_CAP_VIDEO_M2M_MPLANE) != 0;
+    m->out_type = m->mplane ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    m->cap_type = m->mplane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    return true;
+}
+
+static bool import_input_buffers(struct axon_m2m* m, const char* path, int count)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count  = (uint32_t) count;
+    req.type   = m->out_type;
+    req.memory = V4L2_MEMORY_DMABUF;
+    if (xioctl(m->fd, VIDIOC_REQBUFS, &req) < 0 || req.count < (uint32_t) count) {
+        blog(LOG_ERROR, "[axon] %s: DMABUF import not supported", path);
+        return false;
+    }
+    return true;
+}
+
+static bool stream_on(struct axon_m2m* m, const char* path)
+{
+    enum v4l2_buf_type types[2] = {m->out_type, m->cap_type};
+    if (xioctl(m->fd, VIDIOC_STREAMON, &types[0]) < 0 ||
+        xioctl(m->fd, VIDIOC_STREAMON, &types[1]) < 0) {
+        blog(LOG_ERROR, "[axon] %s: failed to start streaming: %s", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static void release_device(struct axon_m2m* m)
+{
+    enum v4l2_buf_type types[2] = {m->out_type, m->cap_type};
+    xioctl(m->fd, VIDIOC_STREAMOFF, &types[0]);
+    xioctl(m->fd, VIDIOC_STREAMOFF, &types[1]);
+    for (int i = 0; i < MAX_CAPTURE_BUFFERS; i++) {
+        if (m->cap_map[i])
+            munmap(m->cap_map[i], m->cap_len[i]);
+    }
+    close(m->fd);
+}
+
+struct axon_m2m* axon_m2m_open(const char* path, const struct axon_m2m_format* in, int out_width,
+                               int out_height, int num_in_buffers)
+{
+    if (!path || !path[0] || !in || in->num_planes < 1 || in->num_planes > 2)
+        return NULL;
+
+    struct axon_m2m* m = (struct axon_m2m*) bzalloc(sizeof(*m));
+    if (!open_device(m, path)) {
+        bfree(m);
+        return NULL;
+    }
+    m->in_planes  = in->num_planes;
+    m->out_width  = out_width;
+    m->out_height = out_height;
+
+    if (!set_input_format(m, in)) {
+        blog(LOG_INFO, "[axon] %s cannot take %.4s %dx%d as laid out by the camera", path,
+             (const char*) &in->fourcc, in->width, in->height);
+        axon_m2m_close(m);
+        return NULL;
+    }
+
+    bool have_output = false;
+    for (size_t i = 0; i < sizeof(output_formats) / sizeof(output_formats[0]); i++) {
+        if (set_output_format(m, output_formats[i])) {
+            have_output = true;
+            break;
+        }
+    }
+    if (!have_output) {
+        blog(LOG_INFO, "[axon] %s cannot produce RGB at %dx%d", path, out_width, out_height);
+        axon_m2m_close(m);
+        return NULL;
+    }
+
+    if (!import_input_buffers(m, path, num_in_buffers) ||
+        !map_capture_buffers(m, M2M_CAPTURE_BUFFERS) || !stream_on(m, path)) {
+        axon_m2m_close(m);
+        return NULL;
+    }
+
+    blog(LOG_INFO, "[axon] %s converts %.4s %dx%d -> %.4s %dx%d", path,
+         (const char*) &in->fourcc, in->width, in->height, (const char*) &m->out_fourcc,
+         out_width, out_height);
+    return m;
+}
+
+void axon_m2m_close(struct axon_m2m* m)
+{
+    if (!m)
+        return;
+    release_device(m);
+    bfree(m);
+}
+
+static bool queue_input(struct axon_m2m* m, int index, const int* fds, const uint32_t* bytesused,
+                        const uint32_t* lengths)
+{
+    struct v4l2_buffer buf;
+    struct v4l2_plane  planes[VIDEO_MAX_PLANES];
+    memset(&buf, 0, sizeof(buf));
+    memset(planes, 0, sizeof(planes));
+    buf.type   = m->out_type;
+    buf.memory = V4L2_MEMORY_DMABUF;
+    buf.index  = (uint32_t) index;
+
+    if (m->mplane) {
+        for (int p = 0; p < m->in_planes; p++) {
+            planes[p].m.fd      = fds[p];
+            planes[p].length    = lengths[p];
+            planes[p].bytesused = bytesused[p] ? bytesused[p] : lengths[p];
+        }
+        buf.m.planes = planes;
+        buf.length   = (uint32_t) m->in_planes;
+    } else {
+        buf.m.fd      = fds[0];
+        buf.length    = lengths[0];
+        buf.bytesused = bytesused[0] ? bytesused[0] : lengths[0];
+    }
+    return xioctl(m->fd, VIDIOC_QBUF, &buf) == 0;
+}
+
+static bool queue_output(struct axon_m2m* m, int index)
+{
+    struct v4l2_buffer buf;
+    struct v4l2_plane  planes[VIDEO_MAX_PLANES];
+    memset(&buf, 0, sizeof(buf));
+    memset(planes, 0, sizeof(planes));
+    buf.type   = m->cap_type;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index  = (uint32_t) index;
+    if (m->mplane) {
+        buf.m.planes = planes;
+        buf.length   = 1;
+    }
+    return xioctl(m->fd, VIDIOC_QBUF, &buf) == 0;
+}
+
+/* 1 dequeued, 0 nothing ready yet, -1 failed; index is set whenever a buffer came back */
+static int dequeue(struct axon_m2m* m, enum v4l2_buf_type type, enum v4l2_memory memory,
+                   int* index, uint32_t* bytesused, uint32_t* flags)
+{
+    struct v4l2_buffer buf;
+    struct v4l2_plane  planes[VIDEO_MAX_PLANES];
+    memset(&buf, 0, sizeof(buf));
+    memset(planes, 0, sizeof(planes));
+    buf.type   = type;
+    buf.memory = memory;
+    if (m->mplane) {
+        buf.m.planes = planes;
+        buf.length   = VIDEO_MAX_PLANES;
+    }
+    if (xioctl(m->fd, VIDIOC_DQBUF, &buf) < 0)
+        return errno == EAGAIN ? 0 : -1;
+    *index = (int) buf.index;
+    if (bytesused)
+        *bytesused = m->mplane ? planes[0].bytesused : buf.bytesused;
+    if (flags)
+        *flags = buf.flags;
+    return (buf.flags & V4L2_BUF_FLAG_ERROR) ? -1 : 1;
+}
+
+static void copy_to_bgra(const struct axon_m2m* m, const uint8_t* src, uint8_t* dst)
+{
+    for (int y = 0; y < m->out_height; y++) {
+        const uint8_t* in  = src + (size_t) y * m->out_stride;
+        uint8_t*       out = dst + (size_t) y * (size_t) m->out_width * 4;
+
+        if (m->out_fourcc == V4L2_PIX_FMT_BGR24 || m->out_fourcc == V4L2_PIX_FMT_RGB24) {
+            int b = m->out_fourcc == V4L2_PIX_FMT_BGR24 ? 0 : 2;
+            for (int x = 0; x < m->out_width; x++) {
+                out[4 * x + 0] = in[3 * x + b];
+                out[4 * x + 1] = in[3 * x + 1];
+                out[4 * x + 2] = in[3 * x + 2 - b];
+                out[4 * x + 3] = 255;
+            }
+        } else {
+            memcpy(out, in, (size_t) m->out_width * 4);
+            for (int x = 0; x < m->out_width; x++)
+                out[4 * x + 3] = 255;
+        }
+    }
+}
+
+bool axon_m2m_convert(struct axon_m2m* m, int index, const int* fds, const uint32_t* bytesused,
+                      const uint32_t* lengths, uint8_t* dst, int timeout_ms)
+{
+    AXON_TRACE_SCOPE("M2M convert");
+
+    int cap_index = m->next_cap;
+    m->next_cap   = (m->next_cap + 1) % m->num_cap;
+
+    if (!queue_output(m, cap_index) || !queue_input(m, index, fds, bytesused, lengths)) {
+        blog(LOG_ERROR, "[axon] M2M QBUF failed: %s", strerror(errno));
+        return false;
+    }
+
+    bool got_in = false, got_out = false, ok = true;
+    int  done_index = -1;
+    while (!got_in || !got_out) {
+        struct pollfd pfd = {m->fd, POLLIN | POLLOUT, 0};
+        int           ret = poll(&pfd, 1, timeout_ms);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0 || (pfd.revents & POLLERR)) {
+            blog(LOG_ERROR, "[axon] M2M conversion timed out");
+            return false;
+        }
+
+        int in_index;
+        if (!got_in && (pfd.revents & POLLOUT))
+            got_in = dequeue(m, m->out_type, V4L2_MEMORY_DMABUF, &in_index, NULL, NULL) != 0;
+        if (!got_out && (pfd.revents & POLLIN)) {
+            int ret_out = dequeue(m, m->cap_type, V4L2_MEMORY_MMAP, &done_index, NULL, NULL);
+            got_out     = ret_out != 0;
+            ok          = ret_out > 0;
+        }
+    }
+
+    if (!ok || done_index < 0 || done_index >= m->num_cap)
+        return false;
+    copy_to_bgra(m, (const uint8_t*) m->cap_map[done_index], dst);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* stateful encoder                                                          */
+
+struct axon_m2m_encoder {
+    struct axon_m2m     m;
+    uint32_t            coded_fourcc;
+    struct axon_watch*  watch;
+    axon_m2m_release_fn release;
+    void*               data;
+
+    FILE*    file;
+    char     file_path[512];
+    uint64_t packets;
+    uint64_t bytes;
+
+    /*
+     * finished packets waiting for the writer task, in stream order; the
+     * loop thread must not block on the disk, so it only queues them
+     */
+    pthread_mutex_t lock;
+    pthread_cond_t  idle;
+    int             pending[MAX_CAPTURE_BUFFERS];
+    uint32_t        pending_used[MAX_CAPTURE_BUFFERS];
+    int             num_pending;
+    bool            writing;
+};
+
+static const struct {
+    uint32_t    fourcc;
+    const char* ext;
+} coded_formats[] = {
+    {V4L2_PIX_FMT_H264, "h264"},
+    {V4L2_PIX_FMT_HEVC, "hevc"},
+    {V4L2_PIX_FMT_FWHT, "fwht"},
+};
+
+static bool device_offers(struct axon_m2m* m, enum v4l2_buf_type type, uint32_t fourcc)
+{
+    struct v4l2_fmtdesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.type = type;
+    for (desc.index = 0; xioctl(m->fd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++) {
+        if (desc.pixelformat == fourcc)
+            return true;
+    }
+    return false;
+}
+
+/* the spec wants the coded format set first; it determines the raw formats offered */
+static bool set_coded_format(struct axon_m2m* m, uint32_t fourcc, int width, int height)
+{
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = m->cap_type;
+
+    uint32_t size = (uint32_t) width * (uint32_t) height * 3 / 2;
+    if (m->mplane) {
+        fmt.fmt.pix_mp.width                  = (uint32_t) width;
+        fmt.fmt.pix_mp.height                 = (uint32_t) height;
+        fmt.fmt.pix_mp.pixelformat            = fourcc;
+        fmt.fmt.pix_mp.num_planes             = 1;
+        fmt.fmt.pix_mp.plane_fmt[0].sizeimage = size;
+    } else {
+        fmt.fmt.pix.width       = (uint32_t) width;
+        fmt.fmt.pix.height      = (uint32_t) height;
+        fmt.fmt.pix.pixelformat = fourcc;
+        fmt.fmt.pix.sizeimage   = size;
+    }
+
+    if (xioctl(m->fd, VIDIOC_S_FMT, &fmt) < 0)
+        return false;
+    return (m->mplane ? fmt.fmt.pix_mp.pixelformat : fmt.fmt.pix.pixelformat) == fourcc;
+}
+
+static void write_packet(struct axon_m2m_encoder* e, int index, uint32_t used)
+{
+    AXON_TRACE_SCOPE("encoder write");
+    if (fwrite(e->m.cap_map[index], 1, used, e->file) == used) {
+        e->packets++;
+        e->bytes += used;
+    }
+}
+
+/* pool task: append the queued packets and give their buffers back to the encoder */
+static void write_task(void* arg)
+{
+    struct axon_m2m_encoder* e = (struct axon_m2m_encoder*) arg;
+
+    pthread_mutex_lock(&e->lock);
+    while (e->num_pending > 0) {
+        int      index = e->pending[0];
+        uint32_t used  = e->pending_used[0];
+        e->num_pending--;
+        memmove(e->pending, e->pending + 1, sizeof(e->pending[0]) * e->num_pending);
+        memmove(e->pending_used, e->pending_used + 1, sizeof(e->pending_used[0]) * e->num_pending);
+        pthread_mutex_unlock(&e->lock);
+
+        write_packet(e, index, used);
+        queue_output(&e->m, index);
+
+        pthread_mutex_lock(&e->lock);
+    }
+    e->writing = false;
+    pthread_cond_broadcast(&e->idle);
+    pthread_mutex_unlock(&e->lock);
+}
+
+static void queue_packet(struct axon_m2m_encoder* e, int index, uint32_t used)
+{
+    pthread_mutex_lock(&e->lock);
+    e->pending[e->num_pending]      = index;
+    e->pending_used[e->num_pending] = used;
+    e->num_pending++;
+    bool start = !e->writing;
+    e->writing = true;
+    pthread_mutex_unlock(&e->lock);
+
+    if (start && !axon_pool_submit(write_task, e, AXON_PRIO_BACKGROUND))
+        write_task(e);
+}
+
+/* hand back the camera buffers the encoder has consumed; true if there were any */
+static bool release_inputs(struct axon_m2m_encoder* e)
+{
+    struct axon_m2m* m        = &e->m;
+    bool             released = false;
+    for (;;) {
+        int index = -1;
+        int ret   = dequeue(m, m->out_type, V4L2_MEMORY_DMABUF, &index, NULL, NULL);
+        if (index >= 0) {
+            e->release(e->data, index);
+            released = true;
+        }
+        if (ret == 0 || index < 0)
+            break;
+    }
+    return released;
+}
+
+/* event loop: hand back consumed camera buffers and pass finished packets to the writer */
+static void encoder_ready(void* data, uint32_t revents)
+{
+    struct axon_m2m_encoder* e = (struct axon_m2m_encoder*) data;
+    struct axon_m2m*         m = &e->m;
+    bool                     progress = release_inputs(e);
+
+    for (;;) {
+        int      index = -1;
+        uint32_t used  = 0;
+        int      ret   = dequeue(m, m->cap_type, V4L2_MEMORY_MMAP, &index, &used, NULL);
+        if (index < 0 || index >= m->num_cap)
+            break;
+        if (ret > 0 && used > 0 && e->file)
+            queue_packet(e, index, used);
+        else
+            queue_output(m, index);
+        progress = true;
+    }
+
+    if (!progress && (revents & POLLERR)) {
+        blog(LOG_WARNING, "[axon] Encoder error, pausing %s", e->file_path);
+        axon_loop_pause(e->watch);
+    }
+}
+
+/*
+ * Close: ask for the frames still inside the encoder and write them out,
+ * up to the buffer flagged LAST, so the recording keeps its final GOP.
+ */
+static void drain_encoder(struct axon_m2m_encoder* e)
+{
+    struct axon_m2m*        m = &e->m;
+    struct v4l2_encoder_cmd cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = V4L2_ENC_CMD_STOP;
+    if (xioctl(m->fd, VIDIOC_ENCODER_CMD, &cmd) < 0) {
+        blog(LOG_WARNING, "[axon] Cannot drain the encoder for %s: %s", e->file_path,
+             strerror(errno));
+        return;
+    }
+
+    uint64_t deadline = os_gettime_ns() + ENCODER_DRAIN_TIMEOUT_MS * 1000000ULL;
+    for (;;) {
+        release_inputs(e);
+
+        int      index = -1;
+        uint32_t used  = 0;
+        uint32_t flags = 0;
+        int      ret   = dequeue(m, m->cap_type, V4L2_MEMORY_MMAP, &index, &used, &flags);
+        if (index >= 0 && index < m->num_cap) {
+            if (ret > 0 && used > 0)
+                write_packet(e, index, used);
+            if (flags & V4L2_BUF_FLAG_LAST)
+                return;
+            queue_output(m, index);
+            continue;
+        }
+        /* EPIPE: the LAST buffer has already been dequeued */
+        if (ret < 0) {
+            if (errno != EPIPE)
+                blog(LOG_WARNING, "[axon] Draining the encoder for %s failed: %s",
+                     e->file_path, strerror(errno));
+            return;
+        }
+
+        uint64_t now = os_gettime_ns();
+        if (now >= deadline) {
+            blog(LOG_WARNING, "[axon] Encoder for %s did not finish draining", e->file_path);
+            return;
+        }
+        struct pollfd pfd = {m->fd, POLLIN | POLLOUT, 0};
+        poll(&pfd, 1, (int) ((deadline - now) / 1000000ULL) + 1);
+    }
+}
+
+struct axon_m2m_encoder* axon_m2m_encoder_open(const char* path, const struct axon_m2m_format* in,
+                                               int num_in_buffers, const char* out_base,
+                                               axon_m2m_release_fn release, void* data)
+{
+    if (!path || !path[0] || !in || in->num_planes < 1 || in->num_planes > 2 || !release)
+        return NULL;
+
+    struct axon_m2m_encoder* e = (struct axon_m2m_encoder*) bzalloc(sizeof(*e));
+    struct axon_m2m*         m = &e->m;
+    e->release                 = release;
+    e->data                    = data;
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_cond_init(&e->idle, NULL);
+    if (!open_device(m, path)) {
+        pthread_cond_destroy(&e->idle);
+        pthread_mutex_destroy(&e->lock);
+        bfree(e);
+        return NULL;
+    }
+    m->in_planes = in->num_planes;
+
+    const char* ext = NULL;
+    for (size_t i = 0; i < sizeof(coded_formats) / sizeof(coded_formats[0]); i++) {
+        if (device_offers(m, m->cap_type, coded_formats[i].fourcc) &&
+            set_coded_format(m, coded_formats[i].fourcc, in->width, in->height)) {
+            e->coded_fourcc = coded_formats[i].fourcc;
+            ext             = coded_formats[i].ext;
+            break;
+        }
+    }
+    if (!ext) {
+        blog(LOG_ERROR, "[axon] %s offers no supported coded format", path);
+        axon_m2m_encoder_close(e);
+        return NULL;
+    }
+
+    if (!set_input_format(m, in)) {
+        blog(LOG_ERROR, "[axon] %s cannot encode %.4s %dx%d as laid out by the camera", path,
+             (const char*) &in->fourcc, in->width, in->height);
+        axon_m2m_encoder_close(e);
+        return NULL;
+    }
+
+    if (!import_input_buffers(m, path, num_in_buffers) ||
+        !map_capture_buffers(m, ENCODER_CAPTURE_BUFFERS) || !stream_on(m, path)) {
+        axon_m2m_encoder_close(e);
+        return NULL;
+    }
+
+    /* keep every packet buffer queued, or poll reports POLLERR while idle */
+    for (int i = 0; i < m->num_cap; i++)
+        queue_output(m, i);
+
+    snprintf(e->file_path, sizeof(e->file_path), "%s.%s", out_base, ext);
+    e->file = fopen(e->file_path, "wb");
+    if (!e->file) {
+        blog(LOG_ERROR, "[axon] Failed to open %s: %s", e->file_path, strerror(errno));
+        axon_m2m_encoder_close(e);
+        return NULL;
+    }
+
+    e->watch = axon_loop_add(m->fd, POLLIN | POLLOUT, encoder_ready, e);
+    if (!e->watch) {
+        axon_m2m_encoder_close(e);
+        return NULL;
+    }
+
+    blog(LOG_INFO, "[axon] %s encodes %.4s %dx%d as %.4s into %s", path,
+         (const char*) &in->fourcc, in->width, in->height, (const char*) &e->coded_fourcc,
+         e->file_path);
+    return e;
+}
+
+void axon_m2m_encoder_close(struct axon_m2m_encoder* e)
+{
+    if (!e)
+        return;
+
+    if (e->watch)
+        axon_loop_remove(e->watch);
+
+    /* packets already queued come first, then whatever the drain brings out */
+    pthread_mutex_lock(&e->lock);
+    while (e->writing)
+        pthread_cond_wait(&e->idle, &e->lock);
+    pthread_mutex_unlock(&e->lock);
+    if (e->watch && e->file)
+        drain_encoder(e);
+
+    release_device(&e->m);
+    if (e->file) {
+        fclose(e->file);
+        blog(LOG_INFO, "[axon] Wrote %llu packets (%llu bytes) to %s",
+             (unsigned long long) e->packets, (unsigned long long) e->bytes, e->file_path);
+    }
+    pthread_cond_destroy(&e->idle);
+    pthread_mutex_destroy(&e->lock);
+    bfree(e);
+}
+
+bool axon_m2m_encoder_submit(struct axon_m2m_encoder* e, int index, const int* fds,
+                             const uint32_t* bytesused, const uint32_t* lengths)
+{
+    AXON_TRACE_SCOPE("encoder submit");
+    return queue_input(&e->m, index, fds, bytesused, lengths);
+}
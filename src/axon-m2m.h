@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Colour conversion and scaling on a V4L2 memory-to-memory device (a SoC
+ * scaler/CSC block, or vim2m for testing). Captured buffers are passed in
+ * by DMABUF, so the frame itself is never copied on the way in; the result
+ * is written to a tightly packed BGRA buffer like the CPU kernels produce.
+ *
+ * Each context is one open() of the device, with its own formats, so a
+ * source can keep one context per output size. Contexts are not thread
+ * safe; a source only ever has one conversion in flight.
+ */
+
+struct axon_m2m_format {
+    uint32_t fourcc;
+    int      width;
+    int      height;
+    int      num_planes;
+    uint32_t bytesperline[2];
+};
+
+struct axon_m2m;
+
+/* NULL if the device cannot take this input or produce out_width x out_height */
+struct axon_m2m* axon_m2m_open(const char* path, const struct axon_m2m_format* in, int out_width,
+                               int out_height, int num_in_buffers);
+void             axon_m2m_close(struct axon_m2m* m);
+
+/*
+ * Blocking round trip of one frame: queue capture buffer `index` (one dmabuf
+ * per plane), wait for the result and convert it into dst (out_width * 4
+ * bytes per row). On failure the context may still hold the input buffer;
+ * close it before giving that buffer back to the camera.
+ */
+bool axon_m2m_convert(struct axon_m2m* m, int index, const int* fds, const uint32_t* bytesused,
+                      const uint32_t* lengths, uint8_t* dst, int timeout_ms);
+
+/*
+ * Stateful encoder (H.264/HEVC on SoC encoder blocks, FWHT on vicodec).
+ * Raw capture buffers go in by DMABUF and the elementary stream is appended
+ * to out_base plus an extension for the coded format. Completion is driven
+ * by the event loop: release(data, index) returns each capture buffer once
+ * the encoder has consumed it, on the loop thread, or in
+ * axon_m2m_encoder_close while it drains. Packets are written to disk by a
+ * pool task, never on the loop thread. Closing sends V4L2_ENC_CMD_STOP and
+ * writes everything up to the LAST buffer, so it blocks for up to a couple
+ * of seconds; buffers the encoder never returns are not released.
+ */
+
+typedef void (*axon_m2m_release_fn)(void* data, int index);
+
+struct axon_m2m_encoder;
+
+struct axon_m2m_encoder* axon_m2m_encoder_open(const char* path, const struct axon_m2m_format* in,
+                                               int num_in_buffers, const char* out_base,
+                                               axon_m2m_release_fn release, void* data);
+void                     axon_m2m_encoder_close(struct axon_m2m_encoder* e);
+
+/* false if the buffer was not accepted; it is then still the caller's */
+bool axon_m2m_encoder_submit(struct axon_m2m_encoder* e, int index, const int* fds,
+                             const uint32_t* bytesused, const uint32_t* lengths);
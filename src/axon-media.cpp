@@ -0,0 +1,410 @@
+#include "axon-media.h"
+
+#include <obs-module.h>
+#include <linux/media.h>
+#include <linux/v4l2-subdev.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define MEDIA_MAX_DEVICES 16
+#define MEDIA_MAX_CHAIN 8
+
+struct media_graph {
+    int                        fd;
+    uint32_t                   version;
+    struct media_v2_topology   topo;
+    struct media_v2_entity*    entities;
+    struct media_v2_interface* interfaces;
+    struct media_v2_pad*       pads;
+    struct media_v2_link*      links;
+};
+
+/* one subdev between the sensor and the video node, sensor first */
+struct chain_node {
+    uint32_t entity;
+    char     name[32];
+    int      sink_pad; /* pad indexes; -1 for the sensor's sink */
+    int      source_pad;
+    char     devnode[64];
+};
+
+static void free_graph(struct media_graph* g)
+{
+    if (g->fd >= 0)
+        close(g->fd);
+    bfree(g->entities);
+    bfree(g->interfaces);
+    bfree(g->pads);
+    bfree(g->links);
+    memset(g, 0, sizeof(*g));
+    g->fd = -1;
+}
+
+static bool load_graph(struct media_graph* g, const char* path)
+{
+    memset(g, 0, sizeof(*g));
+    g->fd = open(path, O_RDWR | O_CLOEXEC);
+    if (g->fd < 0)
+        return false;
+
+    struct media_device_info info;
+    memset(&info, 0, sizeof(info));
+    if (ioctl(g->fd, MEDIA_IOC_DEVICE_INFO, &info) < 0 ||
+        ioctl(g->fd, MEDIA_IOC_G_TOPOLOGY, &g->topo) < 0) {
+        free_graph(g);
+        return false;
+    }
+    g->version = info.media_version;
+
+    /* first call sized the arrays; the topology can change in between, so check the version */
+    uint64_t version = g->topo.topology_version;
+    g->entities   = (struct media_v2_entity*) bzalloc(sizeof(*g->entities) * g->topo.num_entities);
+    g->interfaces = (struct media_v2_interface*) bzalloc(sizeof(*g->interfaces) *
+                                                         g->topo.num_interfaces);
+    g->pads       = (struct media_v2_pad*) bzalloc(sizeof(*g->pads) * g->topo.num_pads);
+    g->links      = (struct media_v2_link*) bzalloc(sizeof(*g->links) * g->topo.num_links);
+    g->topo.ptr_entities   = (uintptr_t) g->entities;
+    g->topo.ptr_interfaces = (uintptr_t) g->interfaces;
+    g->topo.ptr_pads       = (uintptr_t) g->pads;
+    g->topo.ptr_links      = (uintptr_t) g->links;
+
+    if (ioctl(g->fd, MEDIA_IOC_G_TOPOLOGY, &g->topo) < 0 || g->topo.topology_version != version) {
+        free_graph(g);
+        return false;
+    }
+    return true;
+}
+
+static const struct media_v2_pad* find_pad(const struct media_graph* g, uint32_t id)
+{
+    for (uint32_t i = 0; i < g->topo.num_pads; i++) {
+        if (g->pads[i].id == id)
+            return &g->pads[i];
+    }
+    return NULL;
+}
+
+static const struct media_v2_pad* first_pad(const struct media_graph* g, uint32_t entity,
+                                            uint32_t flag)
+{
+    for (uint32_t i = 0; i < g->topo.num_pads; i++) {
+        if (g->pads[i].entity_id == entity && (g->pads[i].flags & flag))
+            return &g->pads[i];
+    }
+    return NULL;
+}
+
+/* before 4.19 pads carry no index; they are reported in index order per entity */
+static int pad_index(const struct media_graph* g, const struct media_v2_pad* pad)
+{
+    if (MEDIA_V2_PAD_HAS_INDEX(g->version))
+        return (int) pad->index;
+
+    int index = 0;
+    for (const struct media_v2_pad* p = g->pads; p != pad; p++) {
+        if (p->entity_id == pad->entity_id)
+            index++;
+    }
+    return index;
+}
+
+static const char* entity_name(const struct media_graph* g, uint32_t id)
+{
+    for (uint32_t i = 0; i < g->topo.num_entities; i++) {
+        if (g->entities[i].id == id)
+            return g->entities[i].name;
+    }
+    return "?";
+}
+
+/* udev names the node; sysfs tells us what it called it */
+static bool devnode_path(uint32_t major, uint32_t minor, char* out, size_t size)
+{
+    char uevent[64];
+    snprintf(uevent, sizeof(uevent), "/sys/dev/char/%u:%u/uevent", major, minor);
+    FILE* f = fopen(uevent, "r");
+    if (!f)
+        return false;
+
+    char line[128];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, "DEVNAME=", 8)) {
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(out, size, "/dev/%s", line + 8);
+            found = true;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+/* entity behind an interface of the given type, optionally matching a device number */
+static bool interface_entity(const struct media_graph* g, uint32_t type, dev_t rdev,
+                             uint32_t* entity)
+{
+    for (uint32_t i = 0; i < g->topo.num_interfaces; i++) {
+        const struct media_v2_interface* intf = &g->interfaces[i];
+        if (intf->intf_type != type || intf->devnode.major != major(rdev) ||
+            intf->devnode.minor != minor(rdev))
+            continue;
+
+        for (uint32_t l = 0; l < g->topo.num_links; l++) {
+            const struct media_v2_link* link = &g->links[l];
+            if ((link->flags & MEDIA_LNK_FL_LINK_TYPE) == MEDIA_LNK_FL_INTERFACE_LINK &&
+                link->source_id == intf->id) {
+                *entity = link->sink_id;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool subdev_devnode(const struct media_graph* g, uint32_t entity, char* out, size_t size)
+{
+    for (uint32_t l = 0; l < g->topo.num_links; l++) {
+        const struct media_v2_link* link = &g->links[l];
+        if ((link->flags & MEDIA_LNK_FL_LINK_TYPE) != MEDIA_LNK_FL_INTERFACE_LINK ||
+            link->sink_id != entity)
+            continue;
+
+        for (uint32_t i = 0; i < g->topo.num_interfaces; i++) {
+            const struct media_v2_interface* intf = &g->interfaces[i];
+            if (intf->id == link->source_id && intf->intf_type == MEDIA_INTF_T_V4L_SUBDEV)
+                return devnode_path(intf->devnode.major, intf->devnode.minor, out, size);
+        }
+    }
+    return false;
+}
+
+/* data link feeding a sink pad; an enabled one wins over candidates we would have to enable */
+static const struct media_v2_link* upstream_link(const struct media_graph* g, uint32_t sink_pad)
+{
+    const struct media_v2_link* best = NULL;
+    for (uint32_t l = 0; l < g->topo.num_links; l++) {
+        const struct media_v2_link* link = &g->links[l];
+        if ((link->flags & MEDIA_LNK_FL_LINK_TYPE) != MEDIA_LNK_FL_DATA_LINK ||
+            link->sink_id != sink_pad)
+            continue;
+        if (link->flags & MEDIA_LNK_FL_ENABLED)
+            return link;
+        if (!best)
+            best = link;
+    }
+    return best;
+}
+
+static void enable_link(const struct media_graph* g, const struct media_v2_link* link)
+{
+    if (link->flags & (MEDIA_LNK_FL_ENABLED | MEDIA_LNK_FL_IMMUTABLE))
+        return;
+
+    const struct media_v2_pad* src  = find_pad(g, link->source_id);
+    const struct media_v2_pad* sink = find_pad(g, link->sink_id);
+    if (!src || !sink)
+        return;
+
+    struct media_link_desc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.source.entity = src->entity_id;
+    desc.source.index  = (uint16_t) pad_index(g, src);
+    desc.sink.entity   = sink->entity_id;
+    desc.sink.index    = (uint16_t) pad_index(g, sink);
+    desc.flags         = MEDIA_LNK_FL_ENABLED;
+    if (ioctl(g->fd, MEDIA_IOC_SETUP_LINK, &desc) < 0) {
+        blog(LOG_WARNING, "[axon] Failed to enable link %s -> %s: %s",
+             entity_name(g, src->entity_id), entity_name(g, sink->entity_id), strerror(errno));
+    }
+}
+
+/* walk upstream from the video node, enabling links, until an entity without sink pads */
+static int build_chain(const struct media_graph* g, uint32_t video_entity,
+                       struct chain_node chain[MEDIA_MAX_CHAIN])
+{
+    struct chain_node          rev[MEDIA_MAX_CHAIN];
+    int                        n    = 0;
+    const struct media_v2_pad* sink = first_pad(g, video_entity, MEDIA_PAD_FL_SINK);
+
+    while (sink && n < MEDIA_MAX_CHAIN) {
+        const struct media_v2_link* link = upstream_link(g, sink->id);
+        if (!link)
+            break;
+        enable_link(g, link);
+
+        const struct media_v2_pad* src = find_pad(g, link->source_id);
+        if (!src)
+            break;
+
+        struct chain_node* node = &rev[n++];
+        memset(node, 0, sizeof(*node));
+        node->entity     = src->entity_id;
+        node->source_pad = pad_index(g, src);
+        snprintf(node->name, sizeof(node->name), "%s", entity_name(g, src->entity_id));
+        if (!subdev_devnode(g, src->entity_id, node->devnode, sizeof(node->devnode)))
+            return 0;
+
+        sink           = first_pad(g, src->entity_id, MEDIA_PAD_FL_SINK);
+        node->sink_pad = sink ? pad_index(g, sink) : -1;
+    }
+
+    for (int i = 0; i < n; i++)
+        chain[i] = rev[n - 1 - i];
+    return n;
+}
+
+static bool subdev_fmt(int fd, unsigned long req, int pad, struct v4l2_mbus_framefmt* fmt)
+{
+    struct v4l2_subdev_format f;
+    memset(&f, 0, sizeof(f));
+    f.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+    f.pad   = (uint32_t) pad;
+    if (req == VIDIOC_SUBDEV_S_FMT)
+        f.format = *fmt;
+    if (ioctl(fd, req, &f) < 0)
+        return false;
+    *fmt = f.format;
+    return true;
+}
+
+/* exact sensor mode if there is one, else the smallest that covers the request */
+static void pick_sensor_size(int fd, int pad, uint32_t code, int* width, int* height)
+{
+    int best_w = 0, best_h = 0;
+    int max_w = 0, max_h = 0;
+
+    struct v4l2_subdev_frame_size_enum fse;
+    memset(&fse, 0, sizeof(fse));
+    fse.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+    fse.pad   = (uint32_t) pad;
+    fse.code  = code;
+    for (fse.index = 0; ioctl(fd, VIDIOC_SUBDEV_ENUM_FRAME_SIZE, &fse) == 0; fse.index++) {
+        int w = (int) fse.max_width, h = (int) fse.max_height;
+        if ((int) fse.min_width <= *width && *width <= w && (int) fse.min_height <= *height &&
+            *height <= h)
+            return;
+        if (w >= *width && h >= *height && (!best_w || w * h < best_w * best_h)) {
+            best_w = w;
+            best_h = h;
+        }
+        if (w * h > max_w * max_h) {
+            max_w = w;
+            max_h = h;
+        }
+    }
+
+    if (best_w) {
+        *width  = best_w;
+        *height = best_h;
+    } else if (max_w) {
+        *width  = max_w;
+        *height = max_h;
+    }
+}
+
+/* sensor mode first, then each subdev takes its upstream format and scales toward the request */
+static bool configure_chain(const struct chain_node* chain, int n, int* width, int* height)
+{
+    struct v4l2_mbus_framefmt fmt;
+    bool                      ok = true;
+
+    for (int i = 0; i < n && ok; i++) {
+        int fd = open(chain[i].devnode, O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            blog(LOG_WARNING, "[axon] Failed to open %s: %s", chain[i].devnode, strerror(errno));
+            return false;
+        }
+
+        if (i > 0)
+            ok = subdev_fmt(fd, VIDIOC_SUBDEV_S_FMT, chain[i].sink_pad, &fmt);
+
+        struct v4l2_mbus_framefmt out;
+        memset(&out, 0, sizeof(out));
+        ok = ok && subdev_fmt(fd, VIDIOC_SUBDEV_G_FMT, chain[i].source_pad, &out);
+        if (ok) {
+            int w = *width, h = *height;
+            if (i == 0)
+                pick_sensor_size(fd, chain[i].source_pad, out.code, &w, &h);
+            out.width  = (uint32_t) w;
+            out.height = (uint32_t) h;
+            ok         = subdev_fmt(fd, VIDIOC_SUBDEV_S_FMT, chain[i].source_pad, &out);
+            fmt        = out;
+            blog(LOG_INFO, "[axon]   %s (%s): %ux%u code 0x%04x", chain[i].name, chain[i].devnode,
+                 fmt.width, fmt.height, fmt.code);
+        }
+        close(fd);
+    }
+
+    if (!ok)
+        return false;
+    *width  = (int) fmt.width;
+    *height = (int) fmt.height;
+    return true;
+}
+
+/* load the graph of the media device the video node belongs to */
+static bool find_graph(const char* video_path, struct media_graph* g, uint32_t* video_entity,
+                       char* path, size_t size)
+{
+    struct stat st;
+    if (stat(video_path, &st) < 0 || !S_ISCHR(st.st_mode))
+        return false;
+
+    for (int i = 0; i < MEDIA_MAX_DEVICES; i++) {
+        snprintf(path, size, "/dev/media%d", i);
+        if (!load_graph(g, path))
+            continue;
+        if (interface_entity(g, MEDIA_INTF_T_V4L_VIDEO, st.st_rdev, video_entity))
+            return true;
+        free_graph(g);
+    }
+    return false;
+}
+
+bool axon_media_setup(const char* video_path, int* width, int* height)
+{
+    struct media_graph g;
+    uint32_t           video_entity;
+    char               path[32];
+    if (!find_graph(video_path, &g, &video_entity, path, sizeof(path)))
+        return false;
+
+    struct chain_node chain[MEDIA_MAX_CHAIN];
+    int               n = build_chain(&g, video_entity, chain);
+    free_graph(&g);
+    if (n == 0)
+        return false;
+
+    int w = *width, h = *height;
+    blog(LOG_INFO, "[axon] Configuring %s pipeline for %s at %dx%d", path, video_path, w, h);
+    if (!configure_chain(chain, n, &w, &h)) {
+        blog(LOG_WARNING, "[axon] Media pipeline setup failed for %s", video_path);
+        return false;
+    }
+    if (w != *width || h != *height)
+        blog(LOG_INFO, "[axon] Pipeline delivers %dx%d instead of %dx%d", w, h, *width, *height);
+    *width  = w;
+    *height = h;
+    return true;
+}
+
+int axon_media_open(const char* video_path)
+{
+    struct media_graph g;
+    uint32_t           video_entity;
+    char               path[32];
+    if (!find_graph(video_path, &g, &video_entity, path, sizeof(path)))
+        return -1;
+
+    int fd = g.fd;
+    g.fd   = -1;
+    free_graph(&g);
+    return fd;
+}
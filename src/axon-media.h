@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * Media controller setup for ISP-style cameras (Raspberry Pi unicam/ISP,
+ * Rockchip rkisp, vimc). The video node is only the end of a graph of
+ * sensor and ISP subdevices; this finds the graph it belongs to, enables
+ * the links upstream of it, and configures each subdev so the requested
+ * size is produced by the sensor mode and the ISP scaler rather than by a
+ * silent S_FMT fallback.
+ *
+ * Returns false when the node has no media graph with subdevices (UVC and
+ * simple drivers), in which case nothing was touched. On success width and
+ * height hold the size the pipeline will deliver.
+ */
+bool axon_media_setup(const char* video_path, int* width, int* height);
+
+/* the /dev/mediaN whose graph contains the video node, for request allocation; -1 if none */
+int axon_media_open(const char* video_path);
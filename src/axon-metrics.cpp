@@ -0,0 +1,360 @@
+#include "axon-metrics.h"
+#include "axon-loop.h"
+#include "axon-pool.h"
+
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define METRICS_MAX_SOURCES 64
+/* a whole scrape, request and response, gets this long before the connection is dropped */
+#define METRICS_CLIENT_TIMEOUT_MS 200
+
+struct metrics_entry {
+    void*                data;
+    axon_metrics_fill_fn fill;
+};
+
+static struct {
+    int                listen_fd;
+    char               socket_path[108];
+    struct axon_watch* watch;
+
+    pthread_mutex_t      lock;
+    struct metrics_entry entries[METRICS_MAX_SOURCES];
+    int                  num_entries;
+} metrics = {-1, "", NULL, PTHREAD_MUTEX_INITIALIZER, {}, 0};
+
+void axon_metrics_register(void* data, axon_metrics_fill_fn fill)
+{
+    pthread_mutex_lock(&metrics.lock);
+    if (metrics.num_entries < METRICS_MAX_SOURCES) {
+        metrics.entries[metrics.num_entries].data = data;
+        metrics.entries[metrics.num_entries].fill = fill;
+        metrics.num_entries++;
+    }
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+void axon_metrics_unregister(void* data)
+{
+    pthread_mutex_lock(&metrics.lock);
+    for (int i = 0; i < metrics.num_entries; i++) {
+        if (metrics.entries[i].data == data) {
+            metrics.entries[i] = metrics.entries[--metrics.num_entries];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+static void cat_label_value(struct dstr* out, const char* value)
+{
+    for (const char* c = value; *c; c++) {
+        if (*c == '\\')
+            dstr_cat(out, "\\\\");
+        else if (*c == '"')
+            dstr_cat(out, "\\\"");
+        else if (*c == '\n')
+            dstr_cat(out, "\\n");
+        else
+            dstr_catf(out, "%c", *c);
+    }
+}
+
+static void cat_labels(struct dstr* out, const struct axon_capture_stats* st, const char* extra)
+{
+    dstr_cat(out, "{source=\"");
+    cat_label_value(out, st->name);
+    dstr_cat(out, "\",device=\"");
+    cat_label_value(out, st->device_path);
+    dstr_cat(out, "\"");
+    if (extra)
+        dstr_catf(out, ",%s", extra);
+    dstr_cat(out, "}");
+}
+
+static void cat_header(struct dstr* out, const char* name, const char* type, const char* help)
+{
+    dstr_catf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void cat_counter(struct dstr* out, const struct axon_capture_stats* stats, int n,
+                        const char* name, const char* help, size_t offset)
+{
+    cat_header(out, name, "counter", help);
+    for (int i = 0; i < n; i++) {
+        uint64_t value = *(const uint64_t*) ((const uint8_t*) &stats[i] + offset);
+        dstr_cat(out, name);
+        cat_labels(out, &stats[i], NULL);
+        dstr_catf(out, " %llu\n", (unsigned long long) value);
+    }
+}
+
+static void cat_histogram(struct dstr* out, const struct axon_capture_stats* stats, int n,
+                          const char* name, const char* help, size_t offset)
+{
+    cat_header(out, name, "histogram", help);
+    for (int i = 0; i < n; i++) {
+        const struct axon_histogram* h =
+            (const struct axon_histogram*) ((const uint8_t*) &stats[i] + offset);
+        uint64_t cumulative = 0;
+        char     le[32];
+
+        for (int b = 0; b <= h->num_bounds; b++) {
+            cumulative += h->counts[b];
+            if (b < h->num_bounds)
+                snprintf(le, sizeof(le), "le=\"%g\"", h->bounds[b]);
+            else
+                snprintf(le, sizeof(le), "le=\"+Inf\"");
+            dstr_catf(out, "%s_bucket", name);
+            cat_labels(out, &stats[i], le);
+            dstr_catf(out, " %llu\n", (unsigned long long) cumulative);
+        }
+        dstr_catf(out, "%s_sum", name);
+        cat_labels(out, &stats[i], NULL);
+        dstr_catf(out, " %g\n", h->sum);
+        dstr_catf(out, "%s_count", name);
+        cat_labels(out, &stats[i], NULL);
+        dstr_catf(out, " %llu\n", (unsigned long long) h->count);
+    }
+}
+
+static void build_exposition(struct dstr* out)
+{
+    struct axon_capture_stats* stats = NULL;
+    int                        n     = 0;
+
+    pthread_mutex_lock(&metrics.lock);
+    if (metrics.num_entries > 0) {
+        stats = (struct axon_capture_stats*) bzalloc(sizeof(*stats) * metrics.num_entries);
+        for (int i = 0; i < metrics.num_entries; i++)
+            metrics.entries[i].fill(metrics.entries[i].data, &stats[n++]);
+    }
+    pthread_mutex_unlock(&metrics.lock);
+
+#define COUNTER(metric, field, help) \
+    cat_counter(out, stats, n, metric, help, offsetof(struct axon_capture_stats, field))
+
+    COUNTER("axon_frames_captured_total", frames_captured, "Frames dequeued from the driver.");
+    COUNTER("axon_frames_converted_total", frames_converted, "Frames converted and published.");
+    COUNTER("axon_frames_skipped_total", frames_late,
+            "Conversions skipped or abandoned past their deadline.");
+    COUNTER("axon_frames_shed_total", frames_shed, "Frames discarded by the overload policy.");
+    COUNTER("axon_frames_m2m_failed_total", frames_m2m_failed,
+            "Frames the hardware converter failed to convert.");
+    COUNTER("axon_frames_dropped_total", frames_dropped, "Driver sequence number gaps.");
+    COUNTER("axon_audio_xruns_total", audio_xruns, "ALSA capture overruns.");
+    COUNTER("axon_overload_transitions_total", overload_transitions,
+            "Transitions into or out of overload shedding.");
+#undef COUNTER
+
+    cat_header(out, "axon_queue_depth", "gauge", "Buffers waiting for or in conversion.");
+    for (int i = 0; i < n; i++) {
+        dstr_cat(out, "axon_queue_depth");
+        cat_labels(out, &stats[i], NULL);
+        dstr_catf(out, " %d\n", stats[i].queue_depth);
+    }
+
+    cat_histogram(out, stats, n, "axon_convert_seconds", "Wall time to convert one frame.",
+                  offsetof(struct axon_capture_stats, convert_seconds));
+    cat_histogram(out, stats, n, "axon_reconfigure_seconds", "Device start/reconfigure time.",
+                  offsetof(struct axon_capture_stats, reconfigure_seconds));
+
+    bfree(stats);
+}
+
+/* wait for events on the non-blocking client socket until the deadline; false on timeout */
+static bool wait_client(int fd, short events, uint64_t deadline)
+{
+    for (;;) {
+        uint64_t now = os_gettime_ns();
+        if (now >= deadline)
+            return false;
+        struct pollfd pfd = {fd, events, 0};
+        int           ret = poll(&pfd, 1, (int) ((deadline - now + 999999) / 1000000));
+        if (ret < 0 && errno == EINTR)
+            continue;
+        return ret > 0 && !(pfd.revents & (POLLERR | POLLNVAL));
+    }
+}
+
+static bool write_all(int fd, const char* buf, size_t len, uint64_t deadline)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN) {
+            if (!wait_client(fd, POLLOUT, deadline))
+                return false;
+            continue;
+        }
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= (size_t) n;
+    }
+    return true;
+}
+
+/* pool task: answer one scrape; a client that stops reading is cut off at the deadline */
+static void serve_client(void* arg)
+{
+    int      fd       = (int) (intptr_t) arg;
+    uint64_t deadline = os_gettime_ns() + METRICS_CLIENT_TIMEOUT_MS * 1000000ULL;
+
+    char    request[512];
+    ssize_t len = 0;
+    if (wait_client(fd, POLLIN, deadline))
+        len = read(fd, request, sizeof(request) - 1);
+    bool http = len >= 4 && !strncmp(request, "GET ", 4);
+
+    struct dstr body;
+    dstr_init(&body);
+    build_exposition(&body);
+
+    bool ok = true;
+    if (http) {
+        char header[160];
+        int  n = snprintf(header, sizeof(header),
+                          "HTTP/1.0 200 OK\r\n"
+                          "Content-Type: text/plain; version=0.0.4\r\n"
+                          "Content-Length: %zu\r\n\r\n",
+                          body.len);
+        ok     = write_all(fd, header, (size_t) n, deadline);
+    }
+    if (ok && body.len)
+        write_all(fd, body.array, body.len, deadline);
+
+    dstr_free(&body);
+    close(fd);
+}
+
+/* event loop callback: accept every pending connection and hand it to the pool */
+static void accept_ready(void* data, uint32_t revents)
+{
+    (void) data;
+    (void) revents;
+
+    for (;;) {
+        int fd = accept4(metrics.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            break;
+        if (!axon_pool_submit(serve_client, (void*) (intptr_t) fd, AXON_PRIO_BACKGROUND))
+            close(fd);
+    }
+}
+
+static int listen_unix(const char* path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        blog(LOG_ERROR, "[axon] Metrics socket path too long: %s", path);
+        return -1;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    /* replace a socket left by an earlier run, but never anything else at that path */
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            blog(LOG_ERROR, "[axon] %s exists and is not a socket, not using it for metrics",
+                 path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+    }
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    snprintf(metrics.socket_path, sizeof(metrics.socket_path), "%s", path);
+    return fd;
+}
+
+static int listen_tcp(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((uint16_t) port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool axon_metrics_init(void)
+{
+    const char* path = getenv("AXON_METRICS_SOCKET");
+    const char* port = getenv("AXON_METRICS_PORT");
+
+    if (path && path[0])
+        metrics.listen_fd = listen_unix(path);
+    else if (port && atoi(port) > 0)
+        metrics.listen_fd = listen_tcp(atoi(port));
+    else
+        return true;
+
+    if (metrics.listen_fd < 0 || listen(metrics.listen_fd, 8) < 0) {
+        blog(LOG_ERROR, "[axon] Failed to open metrics endpoint: %s", strerror(errno));
+        axon_metrics_shutdown();
+        return false;
+    }
+
+    metrics.watch = axon_loop_add(metrics.listen_fd, POLLIN, accept_ready, NULL);
+    if (!metrics.watch) {
+        axon_metrics_shutdown();
+        return false;
+    }
+
+    blog(LOG_INFO, "[axon] Metrics endpoint listening on %s",
+         metrics.socket_path[0] ? metrics.socket_path : port);
+    return true;
+}
+
+void axon_metrics_shutdown(void)
+{
+    if (metrics.watch) {
+        axon_loop_remove(metrics.watch);
+        metrics.watch = NULL;
+    }
+    if (metrics.listen_fd >= 0) {
+        close(metrics.listen_fd);
+        metrics.listen_fd = -1;
+    }
+    if (metrics.socket_path[0]) {
+        unlink(metrics.socket_path);
+        metrics.socket_path[0] = '\0';
+    }
+}
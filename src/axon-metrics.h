@@ -0,0 +1,23 @@
+#pragma once
+
+#include "axon-stats.h"
+
+/*
+ * Optional Prometheus text exposition endpoint for every capture source in
+ * the process. Enabled by the environment at module load:
+ *
+ *   AXON_METRICS_SOCKET=/run/user/1000/obs-axon.sock   (Unix domain socket)
+ *   AXON_METRICS_PORT=9464                             (127.0.0.1 only)
+ *
+ * Clients sending an HTTP GET get an HTTP response; anything else (e.g.
+ * "socat - UNIX-CONNECT:...") gets the bare exposition text.
+ */
+
+typedef void (*axon_metrics_fill_fn)(void* data, struct axon_capture_stats* stats);
+
+bool axon_metrics_init(void);
+void axon_metrics_shutdown(void);
+
+/* the registry lock is held while fill runs, so unregister waits for a scrape */
+void axon_metrics_register(void* data, axon_metrics_fill_fn fill);
+void axon_metrics_unregister(void* data);
@@ -0,0 +1,167 @@
+#include "axon-overlay.h"
+#include "axon-stats.h"
+
+#include <util/platform.h>
+#include <stdio.h>
+#include <string.h>
+
+#define OVERLAY_TEXT_SOURCE "text_ft2_source_v2"
+#define OVERLAY_MARGIN 8
+
+struct axon_overlay {
+    obs_source_t* filter;
+    obs_source_t* text;
+
+    uint32_t interval_ms;
+    int      font_size;
+
+    uint64_t last_update_ns;
+    uint64_t last_converted;
+    char     last_text[256];
+};
+
+static const char* overlay_get_name(void* unused)
+{
+    (void) unused;
+    return "Axon Capture Statistics";
+}
+
+static void overlay_set_text(struct axon_overlay* o, const char* text)
+{
+    if (!o->text || !strcmp(o->last_text, text))
+        return;
+    snprintf(o->last_text, sizeof(o->last_text), "%s", text);
+
+    obs_data_t* settings = obs_data_create();
+    obs_data_t* font     = obs_data_create();
+    obs_data_set_string(font, "face", "Monospace");
+    obs_data_set_int(font, "size", o->font_size);
+    obs_data_set_obj(settings, "font", font);
+    obs_data_set_string(settings, "text", text);
+    obs_data_set_bool(settings, "drop_shadow", true);
+    obs_source_update(o->text, settings);
+    obs_data_release(font);
+    obs_data_release(settings);
+}
+
+static void overlay_update(void* data, obs_data_t* settings)
+{
+    struct axon_overlay* o = (struct axon_overlay*) data;
+
+    o->interval_ms = (uint32_t) obs_data_get_int(settings, "interval_ms");
+    o->font_size   = (int) obs_data_get_int(settings, "font_size");
+
+    /* force a redraw with the new font */
+    o->last_text[0]   = '\0';
+    o->last_update_ns = 0;
+}
+
+static void* overlay_create(obs_data_t* settings, obs_source_t* filter)
+{
+    struct axon_overlay* o = (struct axon_overlay*) bzalloc(sizeof(*o));
+    o->filter              = filter;
+    o->text = obs_source_create_private(OVERLAY_TEXT_SOURCE, "axon-stats-text", NULL);
+    if (!o->text) {
+        blog(LOG_WARNING, "[axon] %s unavailable, statistics overlay disabled",
+             OVERLAY_TEXT_SOURCE);
+    }
+
+    overlay_update(o, settings);
+    return o;
+}
+
+static void overlay_destroy(void* data)
+{
+    struct axon_overlay* o = (struct axon_overlay*) data;
+    obs_source_release(o->text);
+    bfree(o);
+}
+
+/* text is rebuilt at most every interval_ms; the text source caches its texture */
+static void overlay_tick(void* data, float seconds)
+{
+    (void) seconds;
+    struct axon_overlay* o   = (struct axon_overlay*) data;
+    uint64_t             now = os_gettime_ns();
+
+    if (!o->text || now - o->last_update_ns < (uint64_t) o->interval_ms * 1000000ULL)
+        return;
+
+    struct axon_capture_stats st;
+    obs_source_t*             parent = obs_filter_get_parent(o->filter);
+    if (!parent || !axon_source_get_stats(parent, &st)) {
+        overlay_set_text(o, "no axon capture");
+        o->last_update_ns = now;
+        return;
+    }
+
+    double fps = 0.0;
+    if (o->last_update_ns && st.frames_converted >= o->last_converted) {
+        fps = (double) (st.frames_converted - o->last_converted) * 1e9 /
+              (double) (now - o->last_update_ns);
+    }
+    o->last_converted = st.frames_converted;
+    o->last_update_ns = now;
+
+    char glass[48] = "";
+    if (st.glass_latency_ms >= 0.0)
+        snprintf(glass, sizeof(glass), "\nglass-to-glass %.1f ms", st.glass_latency_ms);
+
+    char text[256];
+    snprintf(text, sizeof(text),
+             "%s%s\n%.1f fps  queue %d\nconvert %.2f ms  latency %.1f ms\n"
+             "dropped %llu  late %llu  shed %llu%s",
+             st.device_path, st.overloaded ? "  OVERLOADED" : "", fps, st.queue_depth,
+             st.convert_ms, st.latency_ms, (unsigned long long) st.frames_dropped,
+             (unsigned long long) st.frames_late, (unsigned long long) st.frames_shed, glass);
+    overlay_set_text(o, text);
+}
+
+static void overlay_render(void* data, gs_effect_t* effect)
+{
+    (void) effect;
+    struct axon_overlay* o = (struct axon_overlay*) data;
+
+    obs_source_skip_video_filter(o->filter);
+
+    if (!o->text || !o->last_text[0])
+        return;
+
+    gs_matrix_push();
+    gs_matrix_translate3f((float) OVERLAY_MARGIN, (float) OVERLAY_MARGIN, 0.0f);
+    obs_source_video_render(o->text);
+    gs_matrix_pop();
+}
+
+static void overlay_get_defaults(obs_data_t* settings)
+{
+    obs_data_set_default_int(settings, "interval_ms", 250);
+    obs_data_set_default_int(settings, "font_size", 24);
+}
+
+static obs_properties_t* overlay_get_properties(void* unused)
+{
+    (void) unused;
+    obs_properties_t* props = obs_properties_create();
+
+    obs_property_t* p =
+        obs_properties_add_int(props, "interval_ms", "Update interval", 200, 2000, 50);
+    obs_property_int_set_suffix(p, " ms");
+    obs_properties_add_int(props, "font_size", "Font size", 8, 128, 1);
+
+    return props;
+}
+
+struct obs_source_info axon_overlay_filter_info = {
+    .id             = "axon_capture_stats_filter",
+    .type           = OBS_SOURCE_TYPE_FILTER,
+    .output_flags   = OBS_SOURCE_VIDEO,
+    .get_name       = overlay_get_name,
+    .create         = overlay_create,
+    .destroy        = overlay_destroy,
+    .get_defaults   = overlay_get_defaults,
+    .get_properties = overlay_get_properties,
+    .update         = overlay_update,
+    .video_tick     = overlay_tick,
+    .video_render   = overlay_render,
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <obs-module.h>
+
+/* video filter that draws axon_capture_stats over the camera image */
+extern struct obs_source_info axon_overlay_filter_info;
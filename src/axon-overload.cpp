@@ -0,0 +1,108 @@
+#include "axon-overload.h"
+
+#include <obs-module.h>
+#include <string.h>
+
+#define OVERLOAD_WINDOW_NS 250000000ULL
+#define OVERLOAD_ENTER_WINDOWS 2
+#define OVERLOAD_EXIT_WINDOWS 8
+
+/* leave shedding only well below the trigger so the state does not flap */
+#define OVERLOAD_EXIT_LOAD_RATIO 0.6
+
+static const char* mode_names[] = {
+    "drop_oldest",
+    "drop_newest",
+    "halve_resolution",
+    "halve_framerate",
+};
+
+void axon_overload_init(struct axon_overload* o)
+{
+    enum axon_overload_mode mode  = o->mode;
+    int                     queue = o->queue_threshold;
+    int                     load  = o->load_percent;
+    uint64_t                trans = o->transitions;
+    uint64_t                shed  = o->frames_shed;
+
+    memset(o, 0, sizeof(*o));
+    o->mode            = mode;
+    o->queue_threshold = queue > 0 ? queue : 2;
+    o->load_percent    = load > 0 ? load : 85;
+    o->transitions     = trans;
+    o->frames_shed     = shed;
+}
+
+enum axon_overload_mode axon_overload_mode_from_string(const char* str)
+{
+    for (size_t i = 0; str && i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+        if (!strcmp(str, mode_names[i]))
+            return (enum axon_overload_mode) i;
+    }
+    return AXON_OVERLOAD_DROP_OLDEST;
+}
+
+const char* axon_overload_mode_name(enum axon_overload_mode mode)
+{
+    return mode_names[mode];
+}
+
+void axon_overload_add_busy(struct axon_overload* o, uint64_t ns)
+{
+    __atomic_add_fetch(&o->busy_ns, ns, __ATOMIC_RELAXED);
+}
+
+/* estimate what the load would be without shedding */
+static int full_cost_load(const struct axon_overload* o, int load)
+{
+    if (!o->shedding)
+        return load;
+    if (o->mode == AXON_OVERLOAD_HALVE_RESOLUTION)
+        return load * 4;
+    if (o->mode == AXON_OVERLOAD_HALVE_FRAMERATE)
+        return load * 2;
+    return load;
+}
+
+void axon_overload_sample(struct axon_overload* o, const char* name, uint64_t now, int depth)
+{
+    if (depth > o->max_depth)
+        o->max_depth = depth;
+
+    if (o->window_start_ns == 0) {
+        o->window_start_ns = now;
+        return;
+    }
+    uint64_t window = now - o->window_start_ns;
+    if (window < OVERLOAD_WINDOW_NS)
+        return;
+
+    uint64_t busy = __atomic_exchange_n(&o->busy_ns, 0, __ATOMIC_RELAXED);
+    int      load = (int) (busy * 100 / window);
+    int      est  = full_cost_load(o, load);
+
+    bool over  = o->max_depth >= o->queue_threshold || est >= o->load_percent;
+    bool under = o->max_depth < o->queue_threshold &&
+                 est < (int) (o->load_percent * OVERLOAD_EXIT_LOAD_RATIO);
+
+    o->over_windows  = over ? o->over_windows + 1 : 0;
+    o->under_windows = under ? o->under_windows + 1 : 0;
+
+    if (!o->shedding && o->over_windows >= OVERLOAD_ENTER_WINDOWS) {
+        o->shedding = true;
+        o->transitions++;
+        o->under_windows = 0;
+        blog(LOG_WARNING, "[axon] %s: overloaded (queue=%d, load=%d%%), shedding by %s", name,
+             o->max_depth, load, mode_names[o->mode]);
+    } else if (o->shedding && o->under_windows >= OVERLOAD_EXIT_WINDOWS) {
+        o->shedding = false;
+        o->transitions++;
+        o->over_windows = 0;
+        blog(LOG_INFO, "[axon] %s: recovered from overload (est. load=%d%%), %llu frames shed",
+             name, est, (unsigned long long) o->frames_shed);
+    }
+
+    o->last_load_percent = load;
+    o->max_depth         = 0;
+    o->window_start_ns   = now;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Per-source overload detection with hysteresis. The capture path feeds it
+ * the waiting-buffer depth and the time spent converting; once either stays
+ * above its threshold the configured shedding mode is engaged, and it is
+ * released only after both have been comfortably low for a while.
+ */
+
+enum axon_overload_mode {
+    AXON_OVERLOAD_DROP_OLDEST = 0,
+    AXON_OVERLOAD_DROP_NEWEST,
+    AXON_OVERLOAD_HALVE_RESOLUTION,
+    AXON_OVERLOAD_HALVE_FRAMERATE,
+};
+
+struct axon_overload {
+    /* configuration */
+    enum axon_overload_mode mode;
+    int                     queue_threshold;
+    int                     load_percent;
+
+    /* state */
+    volatile bool shedding;
+    int           over_windows;
+    int           under_windows;
+    uint64_t      window_start_ns;
+    uint64_t      busy_ns;
+    int           max_depth;
+    int           last_load_percent;
+
+    /* counters */
+    uint64_t transitions;
+    uint64_t frames_shed;
+};
+
+void axon_overload_init(struct axon_overload* o);
+
+enum axon_overload_mode axon_overload_mode_from_string(const char* str);
+const char*             axon_overload_mode_name(enum axon_overload_mode mode);
+
+/* conversion time spent on one frame, from any thread */
+void axon_overload_add_busy(struct axon_overload* o, uint64_t ns);
+
+/* called from the capture path after each dequeue; name is used for logging */
+void axon_overload_sample(struct axon_overload* o, const char* name, uint64_t now, int depth);
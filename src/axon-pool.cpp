@@ -0,0 +1,279 @@
+#include "axon-pool.h"
+
+#include <obs-module.h>
+#include <util/threading.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define AXON_POOL_MAX_THREADS 16
+#define AXON_POOL_DEQUE_SIZE 256
+
+struct pool_task {
+    axon_task_fn            fn;
+    void*                   arg;
+    struct axon_stripe_job* job;
+    int                     stripe;
+};
+
+struct pool_deque {
+    struct pool_task tasks[AXON_POOL_DEQUE_SIZE];
+    unsigned         head;
+    unsigned         count;
+};
+
+struct pool_worker {
+    pthread_t         thread;
+    int               index;
+    pthread_mutex_t   lock;
+    struct pool_deque deques[AXON_PRIO_COUNT];
+};
+
+static struct {
+    bool               initialized;
+    volatile bool      stop;
+    int                num_threads;
+    struct pool_worker workers[AXON_POOL_MAX_THREADS];
+
+    /* idle workers sleep here; queued counts tasks in all deques */
+    pthread_mutex_t idle_lock;
+    pthread_cond_t  idle_cond;
+    int             queued;
+    unsigned        next_worker;
+} pool;
+
+static __thread struct pool_worker* current_worker = NULL;
+
+static bool deque_push_back(struct pool_deque* d, const struct pool_task* t)
+{
+    if (d->count == AXON_POOL_DEQUE_SIZE)
+        return false;
+    d->tasks[(d->head + d->count) % AXON_POOL_DEQUE_SIZE] = *t;
+    d->count++;
+    return true;
+}
+
+static bool deque_pop_back(struct pool_deque* d, struct pool_task* t)
+{
+    if (d->count == 0)
+        return false;
+    d->count--;
+    *t = d->tasks[(d->head + d->count) % AXON_POOL_DEQUE_SIZE];
+    return true;
+}
+
+static bool deque_pop_front(struct pool_deque* d, struct pool_task* t)
+{
+    if (d->count == 0)
+        return false;
+    *t      = d->tasks[d->head];
+    d->head = (d->head + 1) % AXON_POOL_DEQUE_SIZE;
+    d->count--;
+    return true;
+}
+
+static void task_taken(void)
+{
+    __atomic_sub_fetch(&pool.queued, 1, __ATOMIC_RELAXED);
+}
+
+/* own deque first (newest, cache-warm), then steal the oldest from others */
+static bool find_task(struct pool_worker* self, struct pool_task* t)
+{
+    for (int prio = 0; prio < AXON_PRIO_COUNT; prio++) {
+        pthread_mutex_lock(&self->lock);
+        bool found = deque_pop_back(&self->deques[prio], t);
+        pthread_mutex_unlock(&self->lock);
+        if (found) {
+            task_taken();
+            return true;
+        }
+
+        for (int n = 1; n < pool.num_threads; n++) {
+            struct pool_worker* victim = &pool.workers[(self->index + n) % pool.num_threads];
+            pthread_mutex_lock(&victim->lock);
+            found = deque_pop_front(&victim->deques[prio], t);
+            pthread_mutex_unlock(&victim->lock);
+            if (found) {
+                task_taken();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void run_task(const struct pool_task* t)
+{
+    if (!t->job) {
+        t->fn(t->arg);
+        return;
+    }
+
+    struct axon_stripe_job* job = t->job;
+    job->fn(job->arg, t->stripe, job->num_stripes);
+    if (__atomic_sub_fetch(&job->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+        job->done(job->arg);
+}
+
+static void* worker_fn(void* arg)
+{
+    struct pool_worker* self = (struct pool_worker*) arg;
+    current_worker           = self;
+
+    char name[16];
+    snprintf(name, sizeof(name), "axon-worker%d", self->index);
+    os_set_thread_name(name);
+
+    for (;;) {
+        struct pool_task t;
+        if (find_task(self, &t)) {
+            run_task(&t);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool.idle_lock);
+        while (!pool.stop && __atomic_load_n(&pool.queued, __ATOMIC_RELAXED) == 0)
+            pthread_cond_wait(&pool.idle_cond, &pool.idle_lock);
+        bool stop = pool.stop && __atomic_load_n(&pool.queued, __ATOMIC_RELAXED) == 0;
+        pthread_mutex_unlock(&pool.idle_lock);
+        if (stop)
+            break;
+    }
+    return NULL;
+}
+
+static struct pool_worker* target_worker(void)
+{
+    if (current_worker)
+        return current_worker;
+    unsigned n = __atomic_fetch_add(&pool.next_worker, 1, __ATOMIC_RELAXED);
+    return &pool.workers[n % (unsigned) pool.num_threads];
+}
+
+static bool push_tasks(struct pool_worker* w, const struct pool_task* tasks, int count,
+                       enum axon_priority priority)
+{
+    int pushed = 0;
+
+    pthread_mutex_lock(&w->lock);
+    while (pushed < count && deque_push_back(&w->deques[priority], &tasks[pushed]))
+        pushed++;
+    pthread_mutex_unlock(&w->lock);
+
+    if (pushed == 0)
+        return false;
+
+    pthread_mutex_lock(&pool.idle_lock);
+    __atomic_add_fetch(&pool.queued, pushed, __ATOMIC_RELAXED);
+    if (pushed > 1)
+        pthread_cond_broadcast(&pool.idle_cond);
+    else
+        pthread_cond_signal(&pool.idle_cond);
+    pthread_mutex_unlock(&pool.idle_lock);
+
+    /* run what did not fit inline rather than losing it */
+    for (int i = pushed; i < count; i++)
+        run_task(&tasks[i]);
+    return true;
+}
+
+bool axon_pool_init(int num_threads)
+{
+    if (pool.initialized)
+        return true;
+
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > AXON_POOL_MAX_THREADS)
+        num_threads = AXON_POOL_MAX_THREADS;
+
+    memset(&pool, 0, sizeof(pool));
+    pthread_mutex_init(&pool.idle_lock, NULL);
+    pthread_cond_init(&pool.idle_cond, NULL);
+    for (int i = 0; i < num_threads; i++) {
+        pool.workers[i].index = i;
+        pthread_mutex_init(&pool.workers[i].lock, NULL);
+    }
+
+    /* workers index num_threads while stealing, so publish it before starting them */
+    pool.num_threads = num_threads;
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&pool.workers[i].thread, NULL, worker_fn, &pool.workers[i]) != 0) {
+            blog(LOG_ERROR, "[axon] Failed to start worker %d", i);
+            pool.stop = true;
+            pthread_mutex_lock(&pool.idle_lock);
+            pthread_cond_broadcast(&pool.idle_cond);
+            pthread_mutex_unlock(&pool.idle_lock);
+            for (int j = 0; j < i; j++)
+                pthread_join(pool.workers[j].thread, NULL);
+            for (int j = 0; j < num_threads; j++)
+                pthread_mutex_destroy(&pool.workers[j].lock);
+            pthread_cond_destroy(&pool.idle_cond);
+            pthread_mutex_destroy(&pool.idle_lock);
+            pool.num_threads = 0;
+            return false;
+        }
+    }
+
+    pool.initialized = true;
+    blog(LOG_INFO, "[axon] Worker pool started with %d threads", pool.num_threads);
+    return true;
+}
+
+void axon_pool_shutdown(void)
+{
+    if (!pool.initialized)
+        return;
+
+    pthread_mutex_lock(&pool.idle_lock);
+    pool.stop = true;
+    pthread_cond_broadcast(&pool.idle_cond);
+    pthread_mutex_unlock(&pool.idle_lock);
+
+    for (int i = 0; i < pool.num_threads; i++)
+        pthread_join(pool.workers[i].thread, NULL);
+    for (int i = 0; i < pool.num_threads; i++)
+        pthread_mutex_destroy(&pool.workers[i].lock);
+
+    pthread_cond_destroy(&pool.idle_cond);
+    pthread_mutex_destroy(&pool.idle_lock);
+    pool.initialized = false;
+}
+
+bool axon_pool_submit(axon_task_fn fn, void* arg, enum axon_priority priority)
+{
+    if (!pool.initialized || !fn)
+        return false;
+
+    struct pool_task t = {fn, arg, NULL, 0};
+    return push_tasks(target_worker(), &t, 1, priority);
+}
+
+void axon_pool_submit_stripes(struct axon_stripe_job* job)
+{
+    int n = job->num_stripes > 0 ? job->num_stripes : 1;
+    if (n > AXON_POOL_DEQUE_SIZE)
+        n = AXON_POOL_DEQUE_SIZE;
+    job->num_stripes = n;
+    job->remaining   = n;
+
+    struct pool_task tasks[AXON_POOL_DEQUE_SIZE];
+    for (int i = 0; i < n; i++) {
+        tasks[i].fn     = NULL;
+        tasks[i].arg    = NULL;
+        tasks[i].job    = job;
+        tasks[i].stripe = i;
+    }
+
+    if (!pool.initialized || !push_tasks(target_worker(), tasks, n, job->priority)) {
+        for (int i = 0; i < n; i++)
+            run_task(&tasks[i]);
+    }
+}
+
+int axon_pool_num_threads(void)
+{
+    return pool.num_threads;
+}
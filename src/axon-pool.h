@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * Fixed-size work-stealing worker pool shared by every capture source.
+ *
+ * Each worker owns one deque per priority level and pops its own work
+ * newest-first; idle workers steal oldest-first from the others, always
+ * draining higher priorities across the whole pool before lower ones.
+ * A frame conversion is submitted as a stripe job so several workers can
+ * share one frame when many cameras deliver at the same instant.
+ */
+
+enum axon_priority {
+    AXON_PRIO_PROGRAM = 0, /* visible in the program output */
+    AXON_PRIO_PREVIEW,     /* showing in preview or a projector only */
+    AXON_PRIO_BACKGROUND,  /* not shown anywhere */
+    AXON_PRIO_COUNT,
+};
+
+typedef void (*axon_task_fn)(void* arg);
+typedef void (*axon_stripe_fn)(void* arg, int stripe, int num_stripes);
+
+/* owned by the submitter and must stay valid until done() has run */
+struct axon_stripe_job {
+    axon_stripe_fn     fn;
+    axon_task_fn       done;
+    void*              arg;
+    int                num_stripes;
+    enum axon_priority priority;
+
+    /* private */
+    volatile int remaining;
+};
+
+bool axon_pool_init(int num_threads);
+void axon_pool_shutdown(void);
+
+bool axon_pool_submit(axon_task_fn fn, void* arg, enum axon_priority priority);
+
+/* runs fn for every stripe (possibly on several workers), then done once */
+void axon_pool_submit_stripes(struct axon_stripe_job* job);
+
+int axon_pool_num_threads(void);
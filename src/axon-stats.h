@@ -0,0 +1,62 @@
+#pragma once
+
+#include <obs-module.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AXON_HISTOGRAM_MAX_BUCKETS 12
+
+/* cumulative-on-export histogram; bounds are upper limits in seconds */
+struct axon_histogram {
+    const double* bounds;
+    int           num_bounds;
+    uint64_t      counts[AXON_HISTOGRAM_MAX_BUCKETS + 1]; /* last one is +Inf */
+    uint64_t      count;
+    double        sum;
+};
+
+static inline void axon_histogram_init(struct axon_histogram* h, const double* bounds, int num)
+{
+    h->bounds     = bounds;
+    h->num_bounds = num < AXON_HISTOGRAM_MAX_BUCKETS ? num : AXON_HISTOGRAM_MAX_BUCKETS;
+}
+
+static inline void axon_histogram_observe(struct axon_histogram* h, double value)
+{
+    int i = 0;
+    while (i < h->num_bounds && value > h->bounds[i])
+        i++;
+    h->counts[i]++;
+    h->count++;
+    h->sum += value;
+}
+
+/* point-in-time view of one capture source, for overlays and exporters */
+struct axon_capture_stats {
+    char device_path[100];
+    char name[64];
+
+    uint64_t frames_captured;   /* dequeued from the driver */
+    uint64_t frames_converted;  /* published to the render path */
+    uint64_t frames_dropped;    /* driver sequence gaps */
+    uint64_t frames_late;       /* skipped or abandoned past their deadline */
+    uint64_t frames_shed;       /* discarded by the overload policy */
+    uint64_t frames_m2m_failed; /* the hardware converter failed on them */
+    uint64_t audio_xruns;
+    uint64_t overload_transitions;
+
+    int    queue_depth;
+    bool   overloaded;
+    double convert_ms;
+    double latency_ms;       /* driver timestamp to texture upload */
+    double glass_latency_ms; /* timecode strip to conversion, < 0 if not measuring */
+
+    /* driver sequence of the frame the last control change landed on, < 0 if unknown */
+    int64_t control_frame;
+
+    struct axon_histogram convert_seconds;
+    struct axon_histogram reconfigure_seconds;
+};
+
+/* false if source is not an axon capture source or has no device open */
+bool axon_source_get_stats(obs_source_t* source, struct axon_capture_stats* stats);
@@ -0,0 +1,90 @@
+#include "axon-sync.h"
+
+#include <obs-module.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#define SYNC_MAX_MEMBERS 32
+
+/* a member that has not published for this long (stopped, hidden) is ignored */
+#define SYNC_STALE_NS 500000000ULL
+
+struct axon_sync_member {
+    bool     in_use;
+    char     group[64];
+    uint64_t newest_ts;
+    uint64_t updated_ns;
+};
+
+/* members live in a static table so a stale pointer never dangles */
+static struct {
+    pthread_mutex_t         lock;
+    struct axon_sync_member members[SYNC_MAX_MEMBERS];
+} sync_groups = {PTHREAD_MUTEX_INITIALIZER, {}};
+
+struct axon_sync_member* axon_sync_join(const char* group)
+{
+    if (!group || !group[0])
+        return NULL;
+
+    struct axon_sync_member* m = NULL;
+    pthread_mutex_lock(&sync_groups.lock);
+    for (int i = 0; i < SYNC_MAX_MEMBERS && !m; i++) {
+        if (!sync_groups.members[i].in_use) {
+            m = &sync_groups.members[i];
+            memset(m, 0, sizeof(*m));
+            m->in_use = true;
+            snprintf(m->group, sizeof(m->group), "%s", group);
+        }
+    }
+    pthread_mutex_unlock(&sync_groups.lock);
+
+    if (!m)
+        blog(LOG_WARNING, "[axon] Too many synchronised sources, not joining '%s'", group);
+    return m;
+}
+
+void axon_sync_leave(struct axon_sync_member* m)
+{
+    if (!m)
+        return;
+    pthread_mutex_lock(&sync_groups.lock);
+    m->in_use = false;
+    pthread_mutex_unlock(&sync_groups.lock);
+}
+
+void axon_sync_publish(struct axon_sync_member* m, uint64_t newest_ts, uint64_t now)
+{
+    pthread_mutex_lock(&sync_groups.lock);
+    m->newest_ts  = newest_ts;
+    m->updated_ns = now;
+    pthread_mutex_unlock(&sync_groups.lock);
+}
+
+uint64_t axon_sync_target(struct axon_sync_member* m, uint64_t max_latency_ns, uint64_t now)
+{
+    uint64_t oldest = UINT64_MAX;
+    uint64_t newest = 0;
+
+    pthread_mutex_lock(&sync_groups.lock);
+    for (int i = 0; i < SYNC_MAX_MEMBERS; i++) {
+        const struct axon_sync_member* o = &sync_groups.members[i];
+        if (!o->in_use || !o->newest_ts || now - o->updated_ns > SYNC_STALE_NS ||
+            strcmp(o->group, m->group))
+            continue;
+        if (o->newest_ts < oldest)
+            oldest = o->newest_ts;
+        if (o->newest_ts > newest)
+            newest = o->newest_ts;
+    }
+    pthread_mutex_unlock(&sync_groups.lock);
+
+    if (!newest)
+        return 0;
+
+    /* the slowest camera sets the pace, within the latency budget of the fastest */
+    if (newest - oldest > max_latency_ns)
+        return newest - max_latency_ns;
+    return oldest;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Frame synchronisation across cameras of the same event. Each source in a
+ * group reports the driver timestamp of the newest frame it could draw; the
+ * group then presents the frames closest to the slowest camera's newest
+ * one, so every angle shows the same instant. The fastest camera is never
+ * held back by more than the configured latency.
+ *
+ * Timestamps must share a clock; V4L2 drivers report CLOCK_MONOTONIC, which
+ * is also what os_gettime_ns() uses for drivers that do not.
+ */
+
+struct axon_sync_member;
+
+/* NULL for an empty group name or when the member table is full */
+struct axon_sync_member* axon_sync_join(const char* group);
+void                     axon_sync_leave(struct axon_sync_member* m);
+
+/* graphics thread, once per tick: newest timestamp this member has ready to draw */
+void axon_sync_publish(struct axon_sync_member* m, uint64_t newest_ts, uint64_t now);
+
+/* timestamp the group should present this tick; 0 when there is nothing to match */
+uint64_t axon_sync_target(struct axon_sync_member* m, uint64_t max_latency_ns, uint64_t now);
@@ -0,0 +1,169 @@
+#include "axon-trace.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_EVENTS_PER_THREAD 16384
+
+/* skip the slots a running writer may be overwriting while we dump */
+#define TRACE_DUMP_MARGIN 64
+
+struct trace_event {
+    const char* name;
+    uint64_t    start_ns;
+    uint64_t    dur_ns;
+};
+
+struct trace_buffer {
+    struct trace_buffer* next;
+    pid_t                tid;
+    char                 thread_name[16];
+    uint64_t             head;
+    struct trace_event   events[TRACE_EVENTS_PER_THREAD];
+};
+
+volatile bool axon_trace_enabled = false;
+
+static pthread_mutex_t      buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_buffer* buffers      = NULL;
+
+static __thread struct trace_buffer* local_buffer = NULL;
+
+static struct trace_buffer* thread_buffer(void)
+{
+    if (local_buffer)
+        return local_buffer;
+
+    struct trace_buffer* b = (struct trace_buffer*) bzalloc(sizeof(*b));
+    b->tid                 = (pid_t) syscall(SYS_gettid);
+    if (pthread_getname_np(pthread_self(), b->thread_name, sizeof(b->thread_name)) != 0)
+        snprintf(b->thread_name, sizeof(b->thread_name), "tid %d", (int) b->tid);
+
+    pthread_mutex_lock(&buffers_lock);
+    b->next = buffers;
+    buffers = b;
+    pthread_mutex_unlock(&buffers_lock);
+
+    local_buffer = b;
+    return b;
+}
+
+void axon_trace_scope::begin()
+{
+    start = os_gettime_ns();
+}
+
+void axon_trace_scope::end()
+{
+    axon_trace_emit(name, start, os_gettime_ns());
+}
+
+void axon_trace_emit(const char* name, uint64_t start_ns, uint64_t end_ns)
+{
+    struct trace_buffer* b = thread_buffer();
+    uint64_t             h = b->head;
+    struct trace_event*  e = &b->events[h % TRACE_EVENTS_PER_THREAD];
+
+    e->name     = name;
+    e->start_ns = start_ns;
+    e->dur_ns   = end_ns - start_ns;
+    __atomic_store_n(&b->head, h + 1, __ATOMIC_RELEASE);
+}
+
+void axon_trace_start(void)
+{
+    axon_trace_enabled = true;
+    blog(LOG_INFO, "[axon] Tracing started");
+}
+
+void axon_trace_stop(void)
+{
+    axon_trace_enabled = false;
+    blog(LOG_INFO, "[axon] Tracing stopped");
+}
+
+/* only call once no thread can emit anymore */
+void axon_trace_shutdown(void)
+{
+    axon_trace_enabled = false;
+
+    pthread_mutex_lock(&buffers_lock);
+    struct trace_buffer* b = buffers;
+    buffers                = NULL;
+    pthread_mutex_unlock(&buffers_lock);
+
+    while (b) {
+        struct trace_buffer* next = b->next;
+        bfree(b);
+        b = next;
+    }
+}
+
+int axon_trace_dump(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        blog(LOG_ERROR, "[axon] Failed to open trace file %s", path);
+        return -1;
+    }
+
+    int  count = 0;
+    bool first = true;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    pthread_mutex_lock(&buffers_lock);
+    for (struct trace_buffer* b = buffers; b; b = b->next) {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                   "\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", (int) b->tid, b->thread_name);
+        first = false;
+
+        uint64_t head  = __atomic_load_n(&b->head, __ATOMIC_ACQUIRE);
+        uint64_t begin = 0;
+        if (head > TRACE_EVENTS_PER_THREAD - TRACE_DUMP_MARGIN)
+            begin = head - (TRACE_EVENTS_PER_THREAD - TRACE_DUMP_MARGIN);
+
+        for (uint64_t i = begin; i < head; i++) {
+            const struct trace_event* e = &b->events[i % TRACE_EVENTS_PER_THREAD];
+            fprintf(f,
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    e->name, (int) b->tid, (double) e->start_ns / 1000.0,
+                    (double) e->dur_ns / 1000.0);
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&buffers_lock);
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    blog(LOG_INFO, "[axon] Wrote %d trace events to %s", count, path);
+    return count;
+}
+
+bool axon_trace_dump_default(void)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "trace-%lld.json", (long long) time(NULL));
+
+    char* path = obs_module_config_path(name);
+    if (!path)
+        return false;
+
+    char* dir = obs_module_config_path("");
+    if (dir) {
+        os_mkdirs(dir);
+        bfree(dir);
+    }
+
+    bool ok = axon_trace_dump(path) >= 0;
+    bfree(path);
+    return ok;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Lightweight scoped trace events, dumped as Chrome/Perfetto JSON.
+ *
+ * Every thread records into its own fixed ring buffer without locking; the
+ * oldest events are overwritten once it is full. While tracing is off a
+ * scope costs one load and a predictable branch. Event names must be string
+ * literals, only the pointer is stored.
+ */
+
+extern volatile bool axon_trace_enabled;
+
+void axon_trace_start(void);
+void axon_trace_stop(void);
+void axon_trace_shutdown(void);
+
+void axon_trace_emit(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+/* writes every buffered event to path; returns the number of events or -1 */
+int axon_trace_dump(const char* path);
+
+/* dump into the plugin config directory under a timestamped name */
+bool axon_trace_dump_default(void);
+
+struct axon_trace_scope {
+    const char* name;
+    uint64_t    start;
+
+    explicit axon_trace_scope(const char* n) : name(n), start(0)
+    {
+        if (axon_trace_enabled)
+            begin();
+    }
+    ~axon_trace_scope()
+    {
+        if (start)
+            end();
+    }
+
+    void begin();
+    void end();
+};
+
+#define AXON_TRACE_CONCAT2(a, b) a##b
+#define AXON_TRACE_CONCAT(a, b) AXON_TRACE_CONCAT2(a, b)
+#define AXON_TRACE_SCOPE(name) \
+    struct axon_trace_scope AXON_TRACE_CONCAT(axon_trace_scope_, __LINE__)(name)
@@ -1,15 +1,34 @@
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <plugin-support.h>
+#include "axon-controls.h"
+#include "axon-convert.h"
+#include "axon-deinterlace.h"
+#include "axon-formats.h"
+#include "axon-latency.h"
+#include "axon-loop.h"
+#include "axon-m2m.h"
+#include "axon-media.h"
+#include "axon-metrics.h"
+#include "axon-overload.h"
+#include "axon-overlay.h"
+#include "axon-pool.h"
+#include "axon-stats.h"
+#include "axon-sync.h"
+#include "axon-trace.h"
 #include <linux/videodev2.h>
+#include <linux/media.h>
 #include <alsa/asoundlib.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <time.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -23,14 +42,57 @@ MODULE_EXPORT const char* obs_module_description(void)
 }
 
 #define BUFFER_COUNT 4
+#define CONVERT_STRIPE_ROWS 64
+#define LATE_STARVE_TICKS 4
+#define TEXTURE_RING_SIZE 4
+#define M2M_TIMEOUT_MS 100
+#define M2M_MAX_SHIFT 2
+
+/* consecutive M2M failures before a format the CPU cannot convert gives up */
+#define M2M_MAX_FAILURES 30
+
+/* restarts after capture errors with no frame in between before a source gives up */
+#define CAPTURE_MAX_RESTARTS 3
+
+/* packed 10-bit 4:2:0, four samples in five bytes; newer than some kernel headers */
+#ifndef V4L2_PIX_FMT_NV15
+#define V4L2_PIX_FMT_NV15 v4l2_fourcc('N', 'V', '1', '5')
+#endif
+
+#define LATENCY_MODE_OFF 0
+#define LATENCY_MODE_MEASURE 1
+#define LATENCY_MODE_INJECT 2
 #define AUDIO_SAMPLE_RATE 48000
 #define AUDIO_CHANNELS 2
 #define AUDIO_FORMAT SND_PCM_FORMAT_S16_LE
 #define AUDIO_FRAMES 1024
+#define AUDIO_MAX_POLLFDS 4
+
+/* drawn until a source has its first frame, as BGRA and as limited range luma */
+#define PLACEHOLDER_GREY 0x25
+#define PLACEHOLDER_LUMA (16 + PLACEHOLDER_GREY * 219 / 255)
+
+/* histogram upper bounds in seconds */
+static const double convert_buckets[]     = {0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.066, 0.1};
+static const double reconfigure_buckets[] = {0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0};
 
 struct buffer {
-    void*  start[VIDEO_MAX_PLANES];
-    size_t length[VIDEO_MAX_PLANES];
+    void*    start[VIDEO_MAX_PLANES];
+    size_t   length[VIDEO_MAX_PLANES];
+    uint32_t bytesused[VIDEO_MAX_PLANES];
+    int      dmabuf[VIDEO_MAX_PLANES];
+};
+
+/* 10-bit capture formats, most preferred first; NV12 is the fallback */
+static const uint32_t deep_formats[] = {
+    V4L2_PIX_FMT_P010,
+    V4L2_PIX_FMT_NV15,
+};
+
+/* capture formats tried against an M2M converter, most preferred first */
+static const uint32_t m2m_input_formats[] = {
+    V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12M, V4L2_PIX_FMT_YUYV,
+    V4L2_PIX_FMT_RGB24, V4L2_PIX_FMT_BGR24,
 };
 
 struct v4l2_mplane_source {
@@ -52,24 +114,221 @@ struct v4l2_mplane_source {
 
     char          device_path[100];
     struct buffer buffers[BUFFER_COUNT];
-
-    gs_texture_t* texture;
-    uint8_t*      rgb_front;
-    uint8_t*      rgb_back;
-    bool          new_frame;
-
-    /* protect front/back swap + fd ops during update */
+    uint32_t      capture_fourcc;
+    bool          dmabuf_exported;
+
+    /* colour description from the negotiated format, for the kernels and async output */
+    uint32_t                   colorspace;
+    uint32_t                   ycbcr_enc;
+    uint32_t                   xfer_func;
+    uint32_t                   quantization;
+    struct axon_convert_format convert_format;
+
+    /* prefer P010/NV15 over NV12 when the device offers them */
+    bool deep_color;
+
+    /* V4L2 cannot signal HLG, so BT.2020 sources say whether they carry it */
+    bool bt2020_hlg;
+
+    /*
+     * async variant: frames go to libobs untouched (NV12 or P010, NV15 is
+     * unpacked to P010) so 10-bit stays 10-bit; no conversion or textures
+     */
+    bool      async;
+    uint16_t* p010_stage;
+
+    /* optional hardware conversion, one M2M context per output shift */
+    char                   m2m_path[100];
+    struct axon_m2m*       m2m[M2M_MAX_SHIFT + 1];
+    struct axon_m2m_format m2m_input;
+    bool                   m2m_active;
+    unsigned               m2m_failed_shifts;
+    int                    m2m_failures;
+    uint64_t               frames_m2m_failed;
+
+    /* record-only mode: frames go to a hardware encoder instead of OBS */
+    char                     encoder_path[100];
+    char                     encode_dir[512];
+    struct axon_m2m_encoder* encoder;
+
+    /*
+     * staging ring: each new frame goes into the slot after the last one
+     * written, so an upload never touches a texture the GPU may still be
+     * sampling; with staged_upload the draw lags the upload by one tick.
+     * A sync group may draw an older slot to line up with other cameras.
+     */
+    gs_texture_t* ring[TEXTURE_RING_SIZE];
+    int           ring_shift[TEXTURE_RING_SIZE];
+    uint64_t      ring_ts[TEXTURE_RING_SIZE];
+    int           ring_write;
+    int           ring_draw;
+    int           ring_staged;
+    bool          staged_upload;
+
+    /*
+     * conversions fill back, convert_done swaps it to front and the render
+     * thread swaps front to upload before reading it, all under frame_lock;
+     * upload is only touched by the graphics thread, so it is copied out
+     * unlocked and freed only inside the graphics context
+     */
+    uint8_t* rgb_front;
+    uint8_t* rgb_back;
+    uint8_t* rgb_upload;
+    bool     new_frame;
+
+    /* frame_lock guards the buffer swaps; it is never held while entering graphics */
     pthread_mutex_t frame_lock;
     pthread_mutex_t io_lock;
-    volatile bool   reconfiguring;
+
+    /*
+     * the device is opened on first show and closed on hide, unless kept
+     * warm. Both run as device tasks on the pool, so many cameras come up
+     * in parallel without stalling the graphics thread; shown is the state
+     * the next task works towards. The device_ fields are under devices.lock.
+     */
+    volatile bool              shown;
+    bool                       keep_warm;
+    bool                       device_queued;
+    int                        device_tasks;
+    struct v4l2_mplane_source* device_next;
+    gs_texture_t*              placeholder;
+
+    /* set by the loop thread on a capture error, for the device task to restart the device */
+    volatile bool capture_failed;
+    int           capture_restarts;
+
+    /* capture is driven by the shared event loop, conversion by the pool */
+    struct axon_watch* video_watch;
+    pthread_mutex_t    capture_lock;
+    pthread_cond_t     capture_cond;
+    bool               convert_busy;
+    int                convert_index;
+
+    /* dequeued buffers waiting for the converter, oldest first */
+    int pending[BUFFER_COUNT];
+    int pending_count;
+
+    struct axon_stripe_job convert_job;
+
+    /* deadline handling: skip or abandon conversions that miss their tick */
+    bool          drop_late;
+    uint64_t      buffer_ts[BUFFER_COUNT];
+    uint64_t      convert_deadline;
+    uint64_t      convert_start_ns;
+    uint64_t      convert_ns_avg;
+    uint64_t      last_publish_ns;
+    volatile bool convert_abandoned;
+    bool          convert_failed;
+    uint64_t      frames_late;
+
+    /* overload shedding; shift is 1 while converting at half resolution */
+    struct axon_overload overload;
+    bool                 shed_toggle;
+    int                  convert_shift;
+    int                  front_shift;
+
+    /* shift applied while the source is not in program (0 = full resolution) */
+    int preview_shift;
+
+    /* rotation/mirroring done by the CPU kernels; output size swaps for 90/270 */
+    struct axon_transform transform;
+
+    /*
+     * interlaced capture: stripes are deinterlaced into a progressive copy and
+     * converted from there. Bob converts both fields; the second is published
+     * one field period after the first.
+     */
+    bool                       interlaced;
+    struct axon_fields         fields;
+    enum axon_deinterlace_mode deinterlace;
+    enum axon_deinterlace_mode convert_deinterlace;
+    int                        convert_fields;
+    uint8_t*                   progressive;
+    uint64_t                   field_period_ns;
+    uint8_t*                   field_front;
+    uint8_t*                   field_back;
+    uint8_t*                   field_upload;
+    bool                       field_pending;
+    uint64_t                   field_ts;
+
+    /* adaptive mode: luma of the last converted frame, and the copy being filled by stripes */
+    uint8_t* history_prev;
+    uint8_t* history_next;
+    bool     history_valid;
+
+    /* optional 3D LUT graded inside the CPU conversion; shared with other sources */
+    char             lut_path[512];
+    struct axon_lut* lut;
+
+    /* configure sensor/ISP subdevs through the media controller before S_FMT */
+    bool media_setup;
+
+    /* last negotiated format, cached per device and request; cached = this start used it */
+    char                      format_key[AXON_FORMAT_KEY];
+    struct axon_cached_format format;
+    bool                      format_cached;
+
+    /* multi-camera sync: present the frame matching the rest of the group */
+    char                     sync_group[64];
+    struct axon_sync_member* sync;
+    uint64_t                 sync_max_latency_ns;
+    uint64_t                 sync_drawn_ts;
+
+    /* camera controls, enumerated on open and applied from the capture path */
+    struct axon_controls controls;
+
+    /*
+     * Request API mode: each buffer is always queued through its own request,
+     * so a control change lands on a known frame instead of "soon"
+     */
+    bool    use_requests;
+    bool    requests_active;
+    int     request_fds[BUFFER_COUNT];
+    bool    request_controls[BUFFER_COUNT];
+    int64_t control_frame;
+
+    /* statistics, see axon_source_get_stats() */
+    uint64_t frames_captured;
+    uint64_t frames_converted;
+    uint64_t frames_dropped;
+    uint32_t last_sequence;
+    bool     have_sequence;
+    uint64_t front_ts;
+    uint64_t latency_ns_avg;
+    uint64_t audio_xruns;
+
+    struct axon_histogram convert_hist;
+    struct axon_histogram reconfigure_hist;
+
+    /* glass-to-glass measurement from an on-screen timecode strip */
+    int      latency_mode;
+    int      latency_row_percent;
+    double   glass_latency_ms;
+    uint64_t latency_decode_failures;
 
     /* audio state */
-    snd_pcm_t*    pcm_handle;
-    char          alsa_device[64];
-    pthread_t     audio_thread;
-    volatile bool audio_running;
+    snd_pcm_t*         pcm_handle;
+    char               alsa_device[64];
+    volatile bool      audio_running;
+    struct pollfd      audio_pfds[AUDIO_MAX_POLLFDS];
+    struct axon_watch* audio_watches[AUDIO_MAX_POLLFDS];
+    int                audio_nfds;
+    int16_t*           audio_buf;
+    uint64_t           audio_start_ts;
+    uint64_t           audio_frame_count;
 };
 
+/* size of the converted picture, after rotation; async frames are passed on unrotated */
+static int output_width(const struct v4l2_mplane_source* s)
+{
+    return !s->async && axon_transform_swaps_axes(&s->transform) ? s->height : s->width;
+}
+
+static int output_height(const struct v4l2_mplane_source* s)
+{
+    return !s->async && axon_transform_swaps_axes(&s->transform) ? s->width : s->height;
+}
+
 static void zero_buffers(struct v4l2_mplane_source* s)
 {
     memset(s->buffers, 0, sizeof(s->buffers));
@@ -88,6 +347,14 @@ static void free_mapped_buffers(struct v4l2_mplane_source* s)
     if (!s)
         return;
 
+    for (int i = 0; s->dmabuf_exported && i < s->num_buffers; i++) {
+        for (int p = 0; p < VIDEO_MAX_PLANES; p++) {
+            if (s->buffers[i].dmabuf[p] >= 0)
+                close(s->buffers[i].dmabuf[p]);
+        }
+    }
+    s->dmabuf_exported = false;
+
     for (int i = 0; i < s->num_buffers; i++) {
         void*  mapped0 = s->buffers[i].start[0];
         size_t len0    = s->buffers[i].length[0];
@@ -111,12 +378,23 @@ static void free_mapped_buffers(struct v4l2_mplane_source* s)
 
 static void destroy_texture(struct v4l2_mplane_source* s)
 {
-    if (!s || !s->texture)
+    bool any = false;
+    for (int i = 0; s && i < TEXTURE_RING_SIZE; i++)
+        any = any || s->ring[i];
+    if (!any)
         return;
+
     obs_enter_graphics();
-    gs_texture_destroy(s->texture);
+    for (int i = 0; i < TEXTURE_RING_SIZE; i++) {
+        gs_texture_destroy(s->ring[i]);
+        s->ring[i] = NULL;
+    }
     obs_leave_graphics();
-    s->texture = NULL;
+    memset(s->ring_ts, 0, sizeof(s->ring_ts));
+    s->ring_write    = 0;
+    s->ring_draw     = -1;
+    s->ring_staged   = -1;
+    s->sync_drawn_ts = 0;
 }
 
 static void destroy_rgb(struct v4l2_mplane_source* s)
@@ -129,147 +407,1145 @@ static void destroy_rgb(struct v4l2_mplane_source* s)
         bfree(s->rgb_back);
         s->rgb_back = NULL;
     }
+    bfree(s->rgb_upload);
+    bfree(s->field_front);
+    bfree(s->field_back);
+    bfree(s->field_upload);
+    bfree(s->progressive);
+    bfree(s->history_prev);
+    bfree(s->history_next);
+    bfree(s->p010_stage);
+    s->rgb_upload    = NULL;
+    s->field_front   = NULL;
+    s->field_back    = NULL;
+    s->field_upload  = NULL;
+    s->progressive   = NULL;
+    s->history_prev  = NULL;
+    s->history_next  = NULL;
+    s->history_valid = false;
+    s->p010_stage    = NULL;
+    s->field_pending = false;
 }
 
+/* the render thread reads rgb_upload unlocked, so buffers only change inside graphics */
+static void release_frames(struct v4l2_mplane_source* s)
+{
+    obs_enter_graphics();
+    destroy_texture(s);
+    destroy_rgb(s);
+    obs_leave_graphics();
+}
+
+/* no conversion is running; called without frame_lock, as it enters graphics */
 static bool alloc_rgb_and_texture(struct v4l2_mplane_source* s)
 {
     // size_t rgb_size = (size_t) s->width * (size_t) s->height * 4;
     size_t rgb_size = (size_t) s->y_stride * (size_t) s->height * 4;
 
+    obs_enter_graphics();
+    destroy_texture(s);
     destroy_rgb(s);
 
-    s->rgb_front = (uint8_t*) bzalloc(rgb_size);
-    s->rgb_back  = (uint8_t*) bzalloc(rgb_size);
-    if (!s->rgb_front || !s->rgb_back) {
-        blog(LOG_ERROR, "[axon] Failed to allocate RGB buffers (%dx%d)", s->width, s->height);
+    s->rgb_front  = (uint8_t*) bzalloc(rgb_size);
+    s->rgb_back   = (uint8_t*) bzalloc(rgb_size);
+    s->rgb_upload = (uint8_t*) bzalloc(rgb_size);
+    if (s->interlaced) {
+        size_t nv12_size = (size_t) s->y_stride * (size_t) s->height +
+                           (size_t) s->uv_stride * (size_t) ((s->height + 1) / 2);
+        size_t y_size    = (size_t) s->y_stride * (size_t) s->height;
+        s->field_front   = (uint8_t*) bzalloc(rgb_size);
+        s->field_back    = (uint8_t*) bzalloc(rgb_size);
+        s->field_upload  = (uint8_t*) bzalloc(rgb_size);
+        s->progressive   = (uint8_t*) bzalloc(nv12_size);
+        s->history_prev  = (uint8_t*) bmalloc(y_size);
+        s->history_next  = (uint8_t*) bmalloc(y_size);
+    }
+    if (!s->rgb_front || !s->rgb_back || !s->rgb_upload ||
+        (s->interlaced && (!s->field_front || !s->field_back || !s->field_upload ||
+                           !s->progressive || !s->history_prev || !s->history_next))) {
+        blog(LOG_ERROR, "[axon] Failed to allocate RGB buffers (%dx%d)", output_width(s),
+             output_height(s));
         destroy_rgb(s);
+        obs_leave_graphics();
         return false;
     }
-    s->new_frame = false;
-
-    destroy_texture(s);
+    s->new_frame   = false;
+    s->front_shift = 0;
 
-    obs_enter_graphics();
+    bool           ok           = true;
     const uint8_t* init_data[1] = {(const uint8_t*) s->rgb_front};
-    s->texture = gs_texture_create(s->width, s->height, GS_BGRA, 1, init_data, GS_DYNAMIC);
-    obs_leave_graphics();
+    for (int i = 0; i < TEXTURE_RING_SIZE; i++) {
+        s->ring[i]       = gs_texture_create(output_width(s), output_height(s), GS_BGRA, 1,
+                                             init_data, GS_DYNAMIC);
+        s->ring_shift[i] = 0;
+        ok               = ok && s->ring[i];
+    }
 
-    if (!s->texture) {
-        blog(LOG_ERROR, "[axon] gs_texture_create failed (%dx%d)", s->width, s->height);
+    if (!ok) {
+        blog(LOG_ERROR, "[axon] gs_texture_create failed (%dx%d)", output_width(s),
+             output_height(s));
+        destroy_texture(s);
         destroy_rgb(s);
+    }
+    obs_leave_graphics();
+    return ok;
+}
+
+static void audio_process(struct v4l2_mplane_source* s, int16_t* buffer,
+                          snd_pcm_sframes_t frames_read)
+{
+    int16_t max_sample = 0;
+    for (int i = 0; i < frames_read * AUDIO_CHANNELS; i++) {
+        if (abs(buffer[i]) > max_sample)
+            max_sample = abs(buffer[i]);
+    }
+    // blog(LOG_INFO, "[audio] max sample = %d", max_sample);
+
+    float boost = 24.0f;
+    for (int i = 0; i < frames_read * AUDIO_CHANNELS; i++) {
+        int32_t tmp = (int32_t) buffer[i] * boost;
+        if (tmp > 32767)
+            tmp = 32767;
+        if (tmp < -32768)
+            tmp = -32768;
+        buffer[i] = (int16_t) tmp;
+    }
+
+    struct obs_source_audio ad = {0};
+    ad.data[0]                 = (uint8_t*) buffer;
+    ad.frames                  = (uint32_t) frames_read;
+    ad.samples_per_sec         = AUDIO_SAMPLE_RATE;
+    ad.speakers                = SPEAKERS_STEREO;
+    ad.format                  = AUDIO_FORMAT_16BIT;
+
+    if (s->audio_start_ts == 0)
+        s->audio_start_ts = os_gettime_ns();
+
+    ad.timestamp = s->audio_start_ts + (s->audio_frame_count * 1000000000ULL / AUDIO_SAMPLE_RATE);
+
+    s->audio_frame_count += frames_read;
+
+    // blog(LOG_INFO, "[audio] frames_read=%ld", (long) frames_read);
+
+    AXON_TRACE_SCOPE("audio output");
+    obs_source_output_audio(s->source, &ad);
+}
+
+/* event loop callback: one of the PCM poll descriptors fired */
+static void audio_ready(void* data, uint32_t revents)
+{
+    struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) data;
+    if (!s->audio_running || !s->pcm_handle)
+        return;
+
+    for (int i = 0; i < s->audio_nfds; i++)
+        s->audio_pfds[i].revents = (short) revents;
+
+    unsigned short pcm_revents = 0;
+    snd_pcm_poll_descriptors_revents(s->pcm_handle, s->audio_pfds, (unsigned int) s->audio_nfds,
+                                     &pcm_revents);
+    if (pcm_revents & POLLERR) {
+        s->audio_xruns++;
+        snd_pcm_prepare(s->pcm_handle);
+        snd_pcm_start(s->pcm_handle);
+        return;
+    }
+    if (!(pcm_revents & POLLIN))
+        return;
+
+    for (;;) {
+        snd_pcm_sframes_t frames_read;
+        {
+            AXON_TRACE_SCOPE("ALSA read");
+            frames_read = snd_pcm_readi(s->pcm_handle, s->audio_buf, AUDIO_FRAMES);
+        }
+        // blog(LOG_INFO, "[audio] frames_read=%ld", (long) frames_read);
+        if (frames_read == -EAGAIN)
+            break;
+        if (frames_read < 0) {
+            if (frames_read == -EPIPE)
+                s->audio_xruns++;
+            snd_pcm_prepare(s->pcm_handle);
+            snd_pcm_start(s->pcm_handle);
+            break;
+        }
+        if (frames_read == 0)
+            break;
+        audio_process(s, s->audio_buf, frames_read);
+    }
+}
+
+static bool start_audio(struct v4l2_mplane_source* s)
+{
+    int nfds = snd_pcm_poll_descriptors_count(s->pcm_handle);
+    if (nfds <= 0 || nfds > AUDIO_MAX_POLLFDS) {
+        blog(LOG_ERROR, "[axon] Unsupported ALSA poll descriptor count %d", nfds);
         return false;
     }
+    s->audio_nfds = snd_pcm_poll_descriptors(s->pcm_handle, s->audio_pfds, (unsigned int) nfds);
+
+    s->audio_buf =
+        (int16_t*) bmalloc(AUDIO_FRAMES * AUDIO_CHANNELS * sizeof(int16_t));
+    s->audio_start_ts    = 0;
+    s->audio_frame_count = 0;
+    s->audio_running     = true;
+
+    for (int i = 0; i < s->audio_nfds; i++) {
+        s->audio_watches[i] =
+            axon_loop_add(s->audio_pfds[i].fd, (uint32_t) s->audio_pfds[i].events, audio_ready, s);
+    }
     return true;
 }
 
-static void nv12_to_bgra(uint8_t* dst, const uint8_t* y_plane, const uint8_t* uv_plane, int width,
-                         int height, int y_stride, int uv_stride)
+static void stop_audio(struct v4l2_mplane_source* s)
 {
-    for (int j = 0; j < height; j++) {
-        const uint8_t* y_row  = y_plane + j * y_stride;
-        const uint8_t* uv_row = uv_plane + (j / 2) * uv_stride;
-        uint8_t*       out    = dst + (size_t) j * (size_t) width * 4;
+    s->audio_running = false;
+    for (int i = 0; i < AUDIO_MAX_POLLFDS; i++) {
+        if (s->audio_watches[i]) {
+            axon_loop_remove(s->audio_watches[i]);
+            s->audio_watches[i] = NULL;
+        }
+    }
+    s->audio_nfds = 0;
 
-        for (int i = 0; i < width; i++) {
-            int y = y_row[i];
-            int u = uv_row[(i / 2) * 2] - 128;
-            int v = uv_row[(i / 2) * 2 + 1] - 128;
+    if (s->audio_buf) {
+        bfree(s->audio_buf);
+        s->audio_buf = NULL;
+    }
+}
 
-            int c = y - 16;
-            int d = u;
-            int e = v;
+static bool queue_buffer(struct v4l2_mplane_source* s, int index)
+{
+    AXON_TRACE_SCOPE("QBUF");
 
-            int r = (298 * c + 409 * e + 128) >> 8;
-            int g = (298 * c - 100 * d - 208 * e + 128) >> 8;
-            int b = (298 * c + 516 * d + 128) >> 8;
+    struct v4l2_buffer qbuf;
+    struct v4l2_plane  qplanes[VIDEO_MAX_PLANES];
+    memset(&qbuf, 0, sizeof(qbuf));
+    memset(qplanes, 0, sizeof(qplanes));
+    qbuf.type     = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    qbuf.memory   = V4L2_MEMORY_MMAP;
+    qbuf.index    = index;
+    qbuf.m.planes = qplanes;
+    qbuf.length   = (unsigned int) ((s->num_planes >= 2) ? 2 : 1);
+
+    /* the request completed with the buffer; reuse it for the next frame */
+    int request_fd = s->requests_active ? s->request_fds[index] : -1;
+    if (request_fd >= 0) {
+        ioctl(request_fd, MEDIA_REQUEST_IOC_REINIT);
+        s->request_controls[index] = axon_controls_apply(&s->controls, s->fd, request_fd);
+        qbuf.flags |= V4L2_BUF_FLAG_REQUEST_FD;
+        qbuf.request_fd = request_fd;
+    }
 
-            if (r < 0)
-                r = 0;
-            if (r > 255)
-                r = 255;
-            if (g < 0)
-                g = 0;
-            if (g > 255)
-                g = 255;
-            if (b < 0)
-                b = 0;
-            if (b > 255)
-                b = 255;
+    if (ioctl(s->fd, VIDIOC_QBUF, &qbuf) < 0) {
+        blog(LOG_ERROR, "[axon] VIDIOC_QBUF failed: %s", strerror(errno));
+        return false;
+    }
+    if (request_fd >= 0 && ioctl(request_fd, MEDIA_REQUEST_IOC_QUEUE) < 0) {
+        blog(LOG_ERROR, "[axon] Failed to queue request: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
 
-            out[4 * i + 0] = (uint8_t) b;
-            out[4 * i + 1] = (uint8_t) g;
-            out[4 * i + 2] = (uint8_t) r;
-            out[4 * i + 3] = 255;
+static void close_requests(struct v4l2_mplane_source* s)
+{
+    for (int i = 0; i < BUFFER_COUNT; i++) {
+        if (s->request_fds[i] >= 0) {
+            close(s->request_fds[i]);
+            s->request_fds[i] = -1;
         }
+        s->request_controls[i] = false;
     }
+    s->requests_active = false;
 }
 
-static void* audio_thread_fn(void* arg)
+/* one request per buffer, allocated up front and recycled with REINIT */
+static bool open_requests(struct v4l2_mplane_source* s, uint32_t capabilities)
 {
-    struct v4l2_mplane_source* s        = (v4l2_mplane_source*) arg;
-    size_t                     buf_size = AUDIO_FRAMES * AUDIO_CHANNELS * sizeof(int16_t);
-    int16_t*                   buffer   = (int16_t*) bmalloc(buf_size);
+    if (!(capabilities & V4L2_BUF_CAP_SUPPORTS_REQUESTS)) {
+        blog(LOG_WARNING, "[axon] %s does not support requests, controls are applied directly",
+             s->device_path);
+        return false;
+    }
+
+    int media_fd = axon_media_open(s->device_path);
+    if (media_fd < 0) {
+        blog(LOG_WARNING, "[axon] No media device for %s, controls are applied directly",
+             s->device_path);
+        return false;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < s->num_buffers && ok; i++) {
+        if (ioctl(media_fd, MEDIA_IOC_REQUEST_ALLOC, &s->request_fds[i]) < 0) {
+            blog(LOG_WARNING, "[axon] MEDIA_IOC_REQUEST_ALLOC failed: %s", strerror(errno));
+            s->request_fds[i] = -1;
+            ok                = false;
+        }
+    }
+    close(media_fd);
+
+    if (!ok)
+        close_requests(s);
+    return ok;
+}
+
+static bool is_nv12(uint32_t fourcc)
+{
+    return fourcc == V4L2_PIX_FMT_NV12 || fourcc == V4L2_PIX_FMT_NV12M;
+}
+
+static bool is_10bit(uint32_t fourcc)
+{
+    return fourcc == V4L2_PIX_FMT_P010 || fourcc == V4L2_PIX_FMT_NV15;
+}
+
+/* formats the CPU kernels read; anything else needs the M2M converter */
+static bool cpu_format(uint32_t fourcc)
+{
+    return is_nv12(fourcc) || is_10bit(fourcc);
+}
+
+/* kernel instantiation for the negotiated format, resolving the driver's colour defaults */
+static struct axon_convert_format capture_format(const struct v4l2_mplane_source* s)
+{
+    struct axon_convert_format f = {AXON_YUV_NV12, AXON_MATRIX_BT601, AXON_RANGE_LIMITED,
+                                    AXON_RGB_BGRA};
+    uint32_t enc   = s->ycbcr_enc;
+    uint32_t quant = s->quantization;
+
+    if (enc == V4L2_YCBCR_ENC_DEFAULT)
+        enc = V4L2_MAP_YCBCR_ENC_DEFAULT(s->colorspace);
+    if (quant == V4L2_QUANTIZATION_DEFAULT)
+        quant = V4L2_MAP_QUANTIZATION_DEFAULT(false, s->colorspace, enc);
+
+    if (s->capture_fourcc == V4L2_PIX_FMT_P010)
+        f.yuv = AXON_YUV_P010;
+    else if (s->capture_fourcc == V4L2_PIX_FMT_NV15)
+        f.yuv = AXON_YUV_NV15;
+
+    if (enc == V4L2_YCBCR_ENC_709 || enc == V4L2_YCBCR_ENC_XV709)
+        f.matrix = AXON_MATRIX_BT709;
+    else if (enc == V4L2_YCBCR_ENC_BT2020 || enc == V4L2_YCBCR_ENC_BT2020_CONST_LUM)
+        f.matrix = AXON_MATRIX_BT2020;
+
+    if (quant == V4L2_QUANTIZATION_FULL_RANGE)
+        f.range = AXON_RANGE_FULL;
+    return f;
+}
+
+static bool frame_planes(struct v4l2_mplane_source* s, int idx, const uint8_t** y_plane,
+                         const uint8_t** uv_plane)
+{
+    *y_plane  = (const uint8_t*) s->buffers[idx].start[0];
+    *uv_plane = NULL;
+
+    if (s->buffers[idx].start[1]) {
+        *uv_plane = (const uint8_t*) s->buffers[idx].start[1];
+    } else if (*y_plane) {
+        *uv_plane = *y_plane + (size_t) s->y_stride * (size_t) s->height;
+    }
+
+    return *y_plane && *uv_plane && (s->rgb_back || s->async);
+}
 
-    while (s->audio_running) {
-        if (!s->pcm_handle) {
+static enum axon_priority source_priority(struct v4l2_mplane_source* s)
+{
+    if (obs_source_active(s->source))
+        return AXON_PRIO_PROGRAM;
+    if (obs_source_showing(s->source))
+        return AXON_PRIO_PREVIEW;
+    return AXON_PRIO_BACKGROUND;
+}
+
+/*
+ * Output is downscaled by 1 << shift. Decided per frame from the same driver
+ * buffers, so going live in program takes effect on the next conversion.
+ */
+static int pick_convert_shift(struct v4l2_mplane_source* s, enum axon_priority priority)
+{
+    int shift = 0;
+    if (s->overload.shedding && s->overload.mode == AXON_OVERLOAD_HALVE_RESOLUTION)
+        shift = 1;
+    if (priority != AXON_PRIO_PROGRAM && s->preview_shift > shift)
+        shift = s->preview_shift;
+    return shift;
+}
+
+static uint64_t frame_deadline(uint64_t capture_ts)
+{
+    uint64_t interval = obs_get_frame_interval_ns();
+    uint64_t tick     = obs_get_video_frame_time();
+    uint64_t due      = capture_ts + interval;
+
+    /* round up to the render tick that would first show the frame */
+    if (!interval || !tick || due <= tick)
+        return due;
+    return tick + ((due - tick + interval - 1) / interval) * interval;
+}
+
+/* never skip so long that the picture freezes under sustained overload */
+static bool may_drop_late(struct v4l2_mplane_source* s, uint64_t now)
+{
+    uint64_t interval = obs_get_frame_interval_ns();
+    return s->drop_late && now - s->last_publish_ns < LATE_STARVE_TICKS * interval;
+}
+
+/* output rows [begin, end) at this shift, from progressive planes */
+static void convert_band(struct v4l2_mplane_source* s, uint8_t* dst, const uint8_t* y_plane,
+                         const uint8_t* uv_plane, int shift, int begin, int end)
+{
+    axon_convert_rows(&s->convert_format, dst, y_plane, uv_plane, s->width >> shift,
+                      s->height >> shift, s->y_stride, s->uv_stride, shift, &s->transform, s->lut,
+                      begin, end);
+}
+
+/* pool stripe: convert an even-aligned band of rows of the claimed buffer */
+static void convert_stripe(void* arg, int stripe, int num_stripes)
+{
+    struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) arg;
+    const uint8_t*             y_plane;
+    const uint8_t*             uv_plane;
+
+    if (s->convert_abandoned || !frame_planes(s, s->convert_index, &y_plane, &uv_plane))
+        return;
+
+    uint64_t now = os_gettime_ns();
+    if (now > s->convert_deadline && may_drop_late(s, now)) {
+        s->convert_abandoned = true;
+        return;
+    }
+
+    int shift  = s->convert_shift;
+    int height = s->height >> shift;
+    int rows   = ((height + num_stripes - 1) / num_stripes + 1) & ~1;
+    int begin  = stripe * rows;
+    int end    = begin + rows < height ? begin + rows : height;
+    if (begin >= end)
+        return;
+
+    AXON_TRACE_SCOPE("convert stripe");
+    enum axon_deinterlace_mode mode = s->convert_deinterlace;
+    if (!s->interlaced || (mode == AXON_DEINTERLACE_OFF && !s->fields.sequential)) {
+        convert_band(s, s->rgb_back, y_plane, uv_plane, shift, begin, end);
+        return;
+    }
+
+    /* the band's source rows, made progressive, then converted while still in cache */
+    uint8_t* py        = s->progressive;
+    uint8_t* puv       = s->progressive + (size_t) s->y_stride * (size_t) s->height;
+    int      src_begin = begin << shift;
+    int      src_end   = (end << shift) < s->height ? end << shift : s->height;
+    int      first     = s->fields.bottom_first ? 1 : 0;
+
+    const uint8_t* prev = s->history_valid ? s->history_prev : NULL;
+
+    axon_deinterlace_rows(py, puv, y_plane, uv_plane, prev, s->width, s->height, s->y_stride,
+                          s->uv_stride, &s->fields, mode, first, src_begin, src_end);
+    convert_band(s, s->rgb_back, py, puv, shift, begin, end);
+
+    if (s->convert_fields == 2) {
+        axon_deinterlace_rows(py, puv, y_plane, uv_plane, prev, s->width, s->height,
+                              s->y_stride, s->uv_stride, &s->fields, mode, first ^ 1, src_begin,
+                              src_end);
+        convert_band(s, s->field_back, py, puv, shift, begin, end);
+    }
+
+    /* keep this frame's luma for the next one; stripes split the rows, the last takes the rest */
+    if (mode == AXON_DEINTERLACE_ADAPTIVE) {
+        int    copy_end = end == height ? s->height : src_end;
+        size_t offset   = (size_t) src_begin * (size_t) s->y_stride;
+        memcpy(s->history_next + offset, y_plane + offset,
+               (size_t) (copy_end - src_begin) * (size_t) s->y_stride);
+    }
+}
+
+/* promote the waiting buffer to the conversion slot, or mark the source idle */
+static bool claim_next(struct v4l2_mplane_source* s)
+{
+    pthread_mutex_lock(&s->capture_lock);
+    if (s->pending_count > 0) {
+        s->convert_index = s->pending[0];
+        s->pending_count--;
+        memmove(s->pending, s->pending + 1, sizeof(int) * s->pending_count);
+        pthread_mutex_unlock(&s->capture_lock);
+        return true;
+    }
+    s->convert_busy  = false;
+    s->convert_index = -1;
+    pthread_cond_broadcast(&s->capture_cond);
+    pthread_mutex_unlock(&s->capture_lock);
+    return false;
+}
+
+static void convert_done(void* arg);
+
+/* lazily open a context per reduced size; a device that cannot scale stays at full size */
+static struct axon_m2m* m2m_context(struct v4l2_mplane_source* s, int shift)
+{
+    if (!s->m2m[shift] && !(s->m2m_failed_shifts & (1u << shift))) {
+        s->m2m[shift] = axon_m2m_open(s->m2m_path, &s->m2m_input, s->width >> shift,
+                                      s->height >> shift, s->num_buffers);
+        if (!s->m2m[shift])
+            s->m2m_failed_shifts |= 1u << shift;
+    }
+    return s->m2m[shift];
+}
+
+/* pool task: convert the claimed buffer on the M2M device, then publish as usual */
+static void m2m_convert_task(void* arg)
+{
+    struct v4l2_mplane_source* s   = (struct v4l2_mplane_source*) arg;
+    int                        idx = s->convert_index;
+    struct buffer*             b   = &s->buffers[idx];
+
+    struct axon_m2m* m = s->m2m_active ? m2m_context(s, s->convert_shift) : NULL;
+    if (s->m2m_active && !m) {
+        s->convert_shift = 0;
+        m                = m2m_context(s, 0);
+    }
+
+    uint32_t lengths[2] = {(uint32_t) b->length[0], (uint32_t) b->length[1]};
+    if (m && s->rgb_back &&
+        axon_m2m_convert(m, idx, b->dmabuf, b->bytesused, lengths, s->rgb_back, M2M_TIMEOUT_MS)) {
+        s->m2m_failures = 0;
+        convert_done(s);
+        return;
+    }
+
+    /* the failed context may still own the camera buffer; closing it hands it back */
+    if (m) {
+        s->frames_m2m_failed++;
+        axon_m2m_close(m);
+        s->m2m[s->convert_shift] = NULL;
+    }
+
+    if (cpu_format(s->capture_fourcc)) {
+        if (s->m2m_active) {
+            blog(LOG_ERROR, "[axon] Hardware conversion failed on %s, using the CPU",
+                 s->device_path);
+            s->m2m_active = false;
+        }
+        convert_stripe(s, 0, 1);
+    } else if (m && ++s->m2m_failures < M2M_MAX_FAILURES) {
+        /* nothing else converts this format: drop the frame, the next one reopens the context */
+        if (s->m2m_failures == 1)
+            blog(LOG_WARNING, "[axon] Hardware conversion failed on %s, retrying",
+                 s->device_path);
+        s->convert_abandoned = true;
+        s->convert_failed    = true;
+    } else {
+        if (s->m2m_active) {
+            blog(LOG_ERROR, "[axon] %s cannot convert %.4s from %s and the CPU cannot either, "
+                            "showing nothing until restarted",
+                 s->m2m_path, (const char*) &s->capture_fourcc, s->device_path);
+            s->m2m_active = false;
+        }
+        s->convert_shift = 0;
+        if (s->rgb_back)
+            memset(s->rgb_back, 0, (size_t) s->width * (size_t) s->height * 4);
+    }
+    convert_done(s);
+}
+
+static void async_colour(struct v4l2_mplane_source* s, struct obs_source_frame* frame)
+{
+    enum video_colorspace cs = VIDEO_CS_601;
+    if (s->xfer_func == V4L2_XFER_FUNC_SMPTE2084) {
+        cs         = VIDEO_CS_2100_PQ;
+        frame->trc = VIDEO_TRC_PQ;
+    } else if (s->convert_format.matrix == AXON_MATRIX_BT2020) {
+        /* libobs only has BT.2020 coefficients under the 2100 spaces; SDR keeps its transfer */
+        cs         = VIDEO_CS_2100_HLG;
+        frame->trc = s->bt2020_hlg ? VIDEO_TRC_HLG : VIDEO_TRC_DEFAULT;
+    } else if (s->convert_format.matrix == AXON_MATRIX_BT709) {
+        cs = VIDEO_CS_709;
+    }
+
+    enum video_range_type range = s->convert_format.range == AXON_RANGE_FULL
+                                      ? VIDEO_RANGE_FULL
+                                      : VIDEO_RANGE_PARTIAL;
+    frame->full_range = range == VIDEO_RANGE_FULL;
+    video_format_get_parameters_for_format(cs, range, frame->format, frame->color_matrix,
+                                           frame->color_range_min, frame->color_range_max);
+}
+
+/* pool task, async sources: hand the buffer to libobs as captured; libobs copies it */
+static void async_output_task(void* arg)
+{
+    struct v4l2_mplane_source* s   = (struct v4l2_mplane_source*) arg;
+    int                        idx = s->convert_index;
+    const uint8_t*             y_plane;
+    const uint8_t*             uv_plane;
+
+    bool nv15 = s->capture_fourcc == V4L2_PIX_FMT_NV15;
+    if (!frame_planes(s, idx, &y_plane, &uv_plane) || (nv15 && !s->p010_stage)) {
+        s->convert_abandoned = true;
+        convert_done(s);
+        return;
+    }
+
+    struct obs_source_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.width       = (uint32_t) s->width;
+    frame.height      = (uint32_t) s->height;
+    frame.timestamp   = s->buffer_ts[idx];
+    frame.format      = is_10bit(s->capture_fourcc) ? VIDEO_FORMAT_P010 : VIDEO_FORMAT_NV12;
+    frame.data[0]     = (uint8_t*) y_plane;
+    frame.data[1]     = (uint8_t*) uv_plane;
+    frame.linesize[0] = (uint32_t) s->y_stride;
+    frame.linesize[1] = (uint32_t) s->uv_stride;
+
+    /* libobs has no packed 10-bit format */
+    if (nv15) {
+        AXON_TRACE_SCOPE("unpack NV15");
+        int       uv_width = (s->width + 1) & ~1;
+        uint16_t* uv_dst   = s->p010_stage + (size_t) s->width * (size_t) s->height;
+        nv15_to_p010_rows(s->p010_stage, uv_dst, y_plane, uv_plane, s->width, s->y_stride,
+                          s->uv_stride, 0, s->height);
+        frame.data[0]     = (uint8_t*) s->p010_stage;
+        frame.data[1]     = (uint8_t*) uv_dst;
+        frame.linesize[0] = (uint32_t) s->width * 2;
+        frame.linesize[1] = (uint32_t) uv_width * 2;
+    }
+
+    async_colour(s, &frame);
+    obs_source_output_video(s->source, &frame);
+    convert_done(s);
+}
+
+static void start_convert(struct v4l2_mplane_source* s)
+{
+    for (;;) {
+        int                idx      = s->convert_index;
+        uint64_t           now      = os_gettime_ns();
+        enum axon_priority priority = source_priority(s);
+
+        s->convert_shift       = pick_convert_shift(s, priority);
+        s->convert_deinterlace = s->deinterlace;
+        s->convert_fields      = 1;
+        if (s->interlaced && s->deinterlace == AXON_DEINTERLACE_BOB && !s->m2m_active)
+            s->convert_fields = 2;
+        int stripes = ((s->height >> s->convert_shift) + CONVERT_STRIPE_ROWS - 1) /
+                      CONVERT_STRIPE_ROWS;
+
+        s->convert_deadline  = frame_deadline(s->buffer_ts[idx]);
+        s->convert_start_ns  = now;
+        s->convert_abandoned = false;
+        s->convert_failed    = false;
+
+        /* a conversion that cannot make its tick only delays the next frame */
+        if (now + s->convert_ns_avg <= s->convert_deadline || !may_drop_late(s, now)) {
+            if (s->async) {
+                if (!axon_pool_submit(async_output_task, s, priority))
+                    async_output_task(s);
+                return;
+            }
+            if (s->m2m_active || !cpu_format(s->capture_fourcc)) {
+                if (!axon_pool_submit(m2m_convert_task, s, priority))
+                    m2m_convert_task(s);
+                return;
+            }
+            s->convert_job.num_stripes = stripes > 0 ? stripes : 1;
+            s->convert_job.priority    = priority;
+            axon_pool_submit_stripes(&s->convert_job);
+            return;
+        }
+
+        s->frames_late++;
+        queue_buffer(s, idx);
+        if (!claim_next(s))
+            return;
+    }
+}
+
+static int latency_row(struct v4l2_mplane_source* s)
+{
+    return (s->height - 1) * s->latency_row_percent / 100;
+}
+
+/* decode the timecode strip from the luma plane and compare with the clock */
+static void measure_latency(struct v4l2_mplane_source* s, const uint8_t* y_plane)
+{
+    uint32_t stamp;
+    if (!axon_latency_decode(y_plane + (size_t) latency_row(s) * s->y_stride, s->width, &stamp)) {
+        s->latency_decode_failures++;
+        return;
+    }
+
+    int elapsed = axon_latency_elapsed_ms(stamp, axon_latency_time_ms(os_gettime_ns()));
+    if (elapsed < 0) {
+        s->latency_decode_failures++;
+        return;
+    }
+
+    if (s->glass_latency_ms < 0.0)
+        s->glass_latency_ms = elapsed;
+    else
+        s->glass_latency_ms += ((double) elapsed - s->glass_latency_ms) / 8.0;
+}
+
+/* runs once all stripes of a frame are done: publish, requeue, pick up the next buffer */
+static void convert_done(void* arg)
+{
+    struct v4l2_mplane_source* s   = (struct v4l2_mplane_source*) arg;
+    int                        idx = s->convert_index;
+    const uint8_t*             y_plane;
+    const uint8_t*             uv_plane;
+
+    /* frames the converter failed on are counted where they failed, not as late */
+    if (s->convert_abandoned) {
+        if (!s->convert_failed)
+            s->frames_late++;
+    } else if (frame_planes(s, idx, &y_plane, &uv_plane)) {
+        /* the copy the stripes just filled is what the next adaptive frame compares against */
+        if (s->interlaced && !s->async && s->convert_deinterlace == AXON_DEINTERLACE_ADAPTIVE) {
+            uint8_t* prev    = s->history_prev;
+            s->history_prev  = s->history_next;
+            s->history_next  = prev;
+            s->history_valid = true;
+        } else {
+            s->history_valid = false;
+        }
+
+        if (s->latency_mode != LATENCY_MODE_OFF && is_nv12(s->capture_fourcc))
+            measure_latency(s, y_plane);
+
+        uint64_t now     = os_gettime_ns();
+        int64_t  elapsed = (int64_t) (now - s->convert_start_ns);
+        s->convert_ns_avg += (elapsed - (int64_t) s->convert_ns_avg) / 8;
+        s->last_publish_ns = now;
+        axon_overload_add_busy(&s->overload, (uint64_t) elapsed);
+        axon_histogram_observe(&s->convert_hist, (double) elapsed / 1e9);
+
+        /* async frames were already handed to libobs; the rest swap into the front buffer */
+        if (s->async) {
+            s->front_ts = s->buffer_ts[idx];
+        } else {
+            AXON_TRACE_SCOPE("swap");
+            pthread_mutex_lock(&s->frame_lock);
+            uint8_t* tmp   = s->rgb_front;
+            s->rgb_front   = s->rgb_back;
+            s->rgb_back    = tmp;
+            s->front_shift = s->convert_shift;
+            s->front_ts    = s->buffer_ts[idx];
+            s->new_frame   = true;
+            if (s->convert_fields == 2) {
+                tmp              = s->field_front;
+                s->field_front   = s->field_back;
+                s->field_back    = tmp;
+                s->field_ts      = s->front_ts + s->field_period_ns;
+                s->field_pending = true;
+            } else {
+                s->field_pending = false;
+            }
+            pthread_mutex_unlock(&s->frame_lock);
+        }
+        s->frames_converted++;
+    }
+    queue_buffer(s, idx);
+
+    if (claim_next(s))
+        start_convert(s);
+}
+
+/* hand a dequeued buffer to the converter, applying the overload policy */
+static void enqueue_frame(struct v4l2_mplane_source* s, int idx)
+{
+    struct axon_overload* o        = &s->overload;
+    bool                  shedding = o->shedding;
+    int                   drop[BUFFER_COUNT];
+    int                   num_drop = 0;
+
+    if (shedding && o->mode == AXON_OVERLOAD_HALVE_FRAMERATE) {
+        s->shed_toggle = !s->shed_toggle;
+        if (s->shed_toggle) {
+            o->frames_shed++;
+            queue_buffer(s, idx);
+            return;
+        }
+    }
+
+    /* one conversion in flight per source; the rest wait in arrival order */
+    pthread_mutex_lock(&s->capture_lock);
+    if (!s->convert_busy) {
+        s->convert_busy  = true;
+        s->convert_index = idx;
+        pthread_mutex_unlock(&s->capture_lock);
+        start_convert(s);
+        return;
+    }
+
+    if (shedding && o->mode == AXON_OVERLOAD_DROP_NEWEST && s->pending_count > 0) {
+        drop[num_drop++] = idx;
+    } else {
+        if (shedding && o->mode == AXON_OVERLOAD_DROP_OLDEST) {
+            while (s->pending_count > 0)
+                drop[num_drop++] = s->pending[--s->pending_count];
+        } else if (s->pending_count == BUFFER_COUNT) {
+            drop[num_drop++] = s->pending[0];
+            s->pending_count--;
+            memmove(s->pending, s->pending + 1, sizeof(int) * s->pending_count);
+        }
+        s->pending[s->pending_count++] = idx;
+    }
+    pthread_mutex_unlock(&s->capture_lock);
+
+    o->frames_shed += shedding ? num_drop : 0;
+    for (int i = 0; i < num_drop; i++)
+        queue_buffer(s, drop[i]);
+}
+
+/* event loop callback: the capture fd is readable */
+static void request_device_state(struct v4l2_mplane_source* s);
+
+static void capture_ready(void* data, uint32_t revents)
+{
+    struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) data;
+    bool                       got_frame = false;
+
+    for (;;) {
+        struct v4l2_buffer buf;
+        struct v4l2_plane  planes[VIDEO_MAX_PLANES];
+        memset(&buf, 0, sizeof(buf));
+        memset(planes, 0, sizeof(planes));
+
+        buf.type     = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        buf.memory   = V4L2_MEMORY_MMAP;
+        buf.m.planes = planes;
+        buf.length   = VIDEO_MAX_PLANES;
+
+        int ret;
+        {
+            AXON_TRACE_SCOPE("DQBUF");
+            ret = ioctl(s->fd, VIDIOC_DQBUF, &buf);
+        }
+        if (ret < 0) {
+            if (errno != EAGAIN)
+                blog(LOG_DEBUG, "[axon] DQBUF error: %s", strerror(errno));
             break;
         }
+        got_frame = true;
 
-        snd_pcm_sframes_t frames_read = snd_pcm_readi(s->pcm_handle, buffer, AUDIO_FRAMES);
-        // blog(LOG_INFO, "[audio] frames_read=%ld", (long) frames_read);
-        if (frames_read < 0) {
-            snd_pcm_prepare(s->pcm_handle);
+        int idx = buf.index;
+        if (idx < 0 || idx >= s->num_buffers) {
+            blog(LOG_ERROR, "[axon] DQBUF invalid index %d", idx);
             continue;
+        }
+
+        s->frames_captured++;
+        if (s->have_sequence && buf.sequence > s->last_sequence + 1)
+            s->frames_dropped += buf.sequence - s->last_sequence - 1;
+        s->last_sequence = buf.sequence;
+        s->have_sequence = true;
+
+        if (s->request_controls[idx]) {
+            s->request_controls[idx] = false;
+            s->control_frame         = buf.sequence;
+            blog(LOG_DEBUG, "[axon] Control change landed on frame %u of %s", buf.sequence,
+                 s->device_path);
+        }
+
+        if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+            s->buffer_ts[idx] = (uint64_t) buf.timestamp.tv_sec * 1000000000ULL +
+                                (uint64_t) buf.timestamp.tv_usec * 1000ULL;
         } else {
-            int16_t max_sample = 0;
-            for (int i = 0; i < frames_read * AUDIO_CHANNELS; i++) {
-                if (abs(buffer[i]) > max_sample)
-                    max_sample = abs(buffer[i]);
+            s->buffer_ts[idx] = os_gettime_ns();
+        }
+
+        /* payload sizes, for the M2M and encoder imports of this buffer */
+        for (int p = 0; p < VIDEO_MAX_PLANES; p++)
+            s->buffers[idx].bytesused[p] = p < (int) buf.length ? planes[p].bytesused : 0;
+
+        /* record-only: no conversion or compositing, the encoder returns the buffer */
+        if (s->encoder) {
+            struct buffer* b          = &s->buffers[idx];
+            uint32_t       lengths[2] = {(uint32_t) b->length[0], (uint32_t) b->length[1]};
+            if (!axon_m2m_encoder_submit(s->encoder, idx, b->dmabuf, b->bytesused, lengths)) {
+                s->frames_late++;
+                queue_buffer(s, idx);
             }
-            // blog(LOG_INFO, "[audio] max sample = %d", max_sample);
+            continue;
         }
 
-        float boost = 24.0f;
-        for (int i = 0; i < frames_read * AUDIO_CHANNELS; i++) {
-            int32_t tmp = (int32_t) buffer[i] * boost;
-            if (tmp > 32767)
-                tmp = 32767;
-            if (tmp < -32768)
-                tmp = -32768;
-            buffer[i] = (int16_t) tmp;
+        /* headless measurement: stamp the frame with its own capture time */
+        if (s->latency_mode == LATENCY_MODE_INJECT && is_nv12(s->capture_fourcc) &&
+            s->buffers[idx].start[0]) {
+            int band = s->height / 20 > 8 ? s->height / 20 : 8;
+            axon_latency_inject((uint8_t*) s->buffers[idx].start[0], s->width, s->height,
+                                s->y_stride, latency_row(s), band,
+                                axon_latency_time_ms(s->buffer_ts[idx]));
         }
 
-        struct obs_source_audio ad = {0};
-        ad.data[0]                 = (uint8_t*) buffer;
-        ad.frames                  = (uint32_t) frames_read;
-        ad.samples_per_sec         = AUDIO_SAMPLE_RATE;
-        ad.speakers                = SPEAKERS_STEREO;
-        ad.format                  = AUDIO_FORMAT_16BIT;
+        enqueue_frame(s, idx);
+    }
 
-        static uint64_t audio_start_ts    = 0;
-        static uint64_t audio_frame_count = 0;
+    /* between frames: pending control changes go to the driver in one batch */
+    if (!s->requests_active)
+        axon_controls_apply(&s->controls, s->fd, -1);
+
+    axon_overload_sample(&s->overload, s->device_path, os_gettime_ns(), s->pending_count);
+
+    /*
+     * vb2 reports POLLERR once streaming has stopped or the queue hit an
+     * error, and keeps reporting it; pause until a device task restarts it
+     */
+    if (got_frame) {
+        s->capture_restarts = 0;
+    } else if (revents & POLLERR) {
+        blog(LOG_WARNING, "[axon] Capture error on %s, restarting it", s->device_path);
+        axon_loop_pause(s->video_watch);
+        s->capture_failed = true;
+        request_device_state(s);
+    }
+}
 
-        if (audio_start_ts == 0)
-            audio_start_ts = os_gettime_ns();
+static void stop_capture(struct v4l2_mplane_source* s)
+{
+    if (s->video_watch) {
+        axon_loop_remove(s->video_watch);
+        s->video_watch = NULL;
+    }
 
-        ad.timestamp = audio_start_ts + (audio_frame_count * 1000000000ULL / AUDIO_SAMPLE_RATE);
+    pthread_mutex_lock(&s->capture_lock);
+    while (s->convert_busy)
+        pthread_cond_wait(&s->capture_cond, &s->capture_lock);
+    s->pending_count = 0;
+    s->convert_index = -1;
+    pthread_mutex_unlock(&s->capture_lock);
+}
 
-        audio_frame_count += frames_read;
+static void close_m2m(struct v4l2_mplane_source* s)
+{
+    for (int i = 0; i <= M2M_MAX_SHIFT; i++) {
+        axon_m2m_close(s->m2m[i]);
+        s->m2m[i] = NULL;
+    }
+    s->m2m_active        = false;
+    s->m2m_failed_shifts = 0;
+    s->m2m_failures      = 0;
+}
 
-        // blog(LOG_INFO, "[audio] frames_read=%ld", (long) frames_read);
+/* first capture format both the camera and the converter take; opens the full-size context */
+static uint32_t open_m2m(struct v4l2_mplane_source* s)
+{
+    for (size_t i = 0; i < sizeof(m2m_input_formats) / sizeof(m2m_input_formats[0]); i++) {
+        struct v4l2_format fmt;
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type                   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        fmt.fmt.pix_mp.width       = s->width;
+        fmt.fmt.pix_mp.height      = s->height;
+        fmt.fmt.pix_mp.pixelformat = m2m_input_formats[i];
+        if (ioctl(s->fd, VIDIOC_TRY_FMT, &fmt) < 0 ||
+            fmt.fmt.pix_mp.pixelformat != m2m_input_formats[i])
+            continue;
 
-        obs_source_output_audio(s->source, &ad);
+        struct axon_m2m_format in;
+        memset(&in, 0, sizeof(in));
+        in.fourcc     = fmt.fmt.pix_mp.pixelformat;
+        in.width      = (int) fmt.fmt.pix_mp.width;
+        in.height     = (int) fmt.fmt.pix_mp.height;
+        in.num_planes = fmt.fmt.pix_mp.num_planes >= 2 ? 2 : 1;
+        for (int p = 0; p < in.num_planes; p++)
+            in.bytesperline[p] = fmt.fmt.pix_mp.plane_fmt[p].bytesperline;
+
+        s->m2m[0] = axon_m2m_open(s->m2m_path, &in, in.width, in.height, BUFFER_COUNT);
+        if (s->m2m[0]) {
+            s->m2m_input = in;
+            return in.fourcc;
+        }
     }
 
-    bfree(buffer);
-    return NULL;
+    blog(LOG_WARNING, "[axon] %s shares no usable format with %s, converting on the CPU",
+         s->m2m_path, s->device_path);
+    return V4L2_PIX_FMT_NV12;
+}
+
+/* hand the converter the capture buffers themselves rather than copies */
+static bool export_dmabufs(struct v4l2_mplane_source* s)
+{
+    int planes = s->num_planes >= 2 ? 2 : 1;
+
+    for (int i = 0; i < s->num_buffers; i++) {
+        for (int p = 0; p < VIDEO_MAX_PLANES; p++)
+            s->buffers[i].dmabuf[p] = -1;
+    }
+    s->dmabuf_exported = true;
+
+    for (int i = 0; i < s->num_buffers; i++) {
+        for (int p = 0; p < planes; p++) {
+            struct v4l2_exportbuffer exp;
+            memset(&exp, 0, sizeof(exp));
+            exp.type  = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+            exp.index = (uint32_t) i;
+            exp.plane = (uint32_t) p;
+            exp.flags = O_RDONLY | O_CLOEXEC;
+            if (ioctl(s->fd, VIDIOC_EXPBUF, &exp) < 0) {
+                blog(LOG_ERROR, "[axon] VIDIOC_EXPBUF failed: %s", strerror(errno));
+                return false;
+            }
+            s->buffers[i].dmabuf[p] = exp.fd;
+        }
+    }
+    return true;
+}
+
+/* loop thread, or a draining close: the encoder has read the buffer, give it back */
+static void encoder_release(void* data, int index)
+{
+    queue_buffer((struct v4l2_mplane_source*) data, index);
+}
+
+static void close_encoder(struct v4l2_mplane_source* s)
+{
+    axon_m2m_encoder_close(s->encoder);
+    s->encoder = NULL;
+}
+
+static bool open_encoder(struct v4l2_mplane_source* s)
+{
+    if (!s->dmabuf_exported && !export_dmabufs(s))
+        return false;
+
+    struct axon_m2m_format in;
+    memset(&in, 0, sizeof(in));
+    in.fourcc          = s->capture_fourcc;
+    in.width           = s->width;
+    in.height          = s->height;
+    in.num_planes      = s->num_planes >= 2 ? 2 : 1;
+    in.bytesperline[0] = (uint32_t) s->y_stride;
+    in.bytesperline[1] = (uint32_t) s->uv_stride;
+
+    char* dir = s->encode_dir[0] ? bstrdup(s->encode_dir) : obs_module_config_path("recordings");
+    if (!dir)
+        return false;
+    os_mkdirs(dir);
+
+    const char* dev_name = strrchr(s->device_path, '/');
+    char        base[700];
+    snprintf(base, sizeof(base), "%s/axon-%s-%lld", dir, dev_name ? dev_name + 1 : "camera",
+             (long long) time(NULL));
+    bfree(dir);
+
+    s->encoder = axon_m2m_encoder_open(s->encoder_path, &in, s->num_buffers, base,
+                                       encoder_release, s);
+    return s->encoder != NULL;
+}
+
+/*
+ * Field layout from the negotiated format. Buffers holding a single field
+ * (ALTERNATE) are not supported, so the driver is asked for both in one.
+ */
+static bool read_fields(struct v4l2_mplane_source* s, struct v4l2_format* fmt)
+{
+    if (fmt->fmt.pix_mp.field == V4L2_FIELD_ALTERNATE) {
+        fmt->fmt.pix_mp.field = V4L2_FIELD_INTERLACED;
+        if (ioctl(s->fd, VIDIOC_S_FMT, fmt) < 0 ||
+            fmt->fmt.pix_mp.field == V4L2_FIELD_ALTERNATE) {
+            blog(LOG_ERROR, "[axon] %s only delivers alternate fields", s->device_path);
+            return false;
+        }
+    }
+
+    memset(&s->fields, 0, sizeof(s->fields));
+    s->interlaced = true;
+    switch (fmt->fmt.pix_mp.field) {
+    case V4L2_FIELD_INTERLACED_TB:
+        break;
+    case V4L2_FIELD_INTERLACED_BT:
+        s->fields.bottom_first = true;
+        break;
+    case V4L2_FIELD_SEQ_TB:
+        s->fields.sequential = true;
+        break;
+    case V4L2_FIELD_SEQ_BT:
+        s->fields.sequential   = true;
+        s->fields.bottom_first = true;
+        break;
+    case V4L2_FIELD_INTERLACED: {
+        /* temporal order follows the standard: 525-line systems send the bottom field first */
+        v4l2_std_id std        = 0;
+        s->fields.bottom_first = ioctl(s->fd, VIDIOC_G_STD, &std) == 0 && (std & V4L2_STD_525_60);
+        break;
+    }
+    default:
+        s->interlaced = false;
+        return true;
+    }
+
+    struct v4l2_streamparm parm;
+    memset(&parm, 0, sizeof(parm));
+    parm.type                          = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    const struct v4l2_fract* per_frame = &parm.parm.capture.timeperframe;
+    if (ioctl(s->fd, VIDIOC_G_PARM, &parm) == 0 && per_frame->numerator &&
+        per_frame->denominator)
+        s->field_period_ns =
+            (uint64_t) per_frame->numerator * 500000000ULL / per_frame->denominator;
+    else
+        s->field_period_ns = obs_get_frame_interval_ns() / 2;
+
+    blog(LOG_INFO, "[axon] %s is interlaced (%s, %s field first)", s->device_path,
+         s->fields.sequential ? "sequential fields" : "interleaved lines",
+         s->fields.bottom_first ? "bottom" : "top");
+    return true;
+}
+
+/* device identity and what is asked of it; false when the driver will not say who it is */
+static bool format_key(struct v4l2_mplane_source* s, uint32_t fourcc)
+{
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    s->format_key[0] = 0;
+    if (ioctl(s->fd, VIDIOC_QUERYCAP, &cap) < 0 || !cap.bus_info[0])
+        return false;
+
+    snprintf(s->format_key, sizeof(s->format_key), "%.16s/%.32s/%.32s/%u %dx%d %.4s%s%s%s",
+             (const char*) cap.driver, (const char*) cap.card, (const char*) cap.bus_info,
+             cap.version, s->width, s->height, (const char*) &fourcc,
+             s->deep_color ? " deep" : "", s->async ? " async" : "",
+             s->media_setup ? " media" : "");
+    return true;
+}
+
+static bool format_matches(const struct axon_cached_format* c, const struct v4l2_format* fmt)
+{
+    const struct v4l2_pix_format_mplane* pix = &fmt->fmt.pix_mp;
+    if (pix->pixelformat != c->fourcc || pix->width != c->width || pix->height != c->height ||
+        pix->field != c->field || pix->num_planes != c->num_planes)
+        return false;
+    for (uint32_t p = 0; p < c->num_planes && p < AXON_FORMAT_PLANES; p++) {
+        if (pix->plane_fmt[p].bytesperline != c->bytesperline[p] ||
+            pix->plane_fmt[p].sizeimage != c->sizeimage[p])
+            return false;
+    }
+    return true;
 }
 
-static bool start_device(struct v4l2_mplane_source* s)
+/*
+ * Fast path to a cached format. With set false this only checks whether the
+ * device still has it (a relaunch, or a restart of the same source), which
+ * skips S_FMT and the media setup altogether; with set true it is one S_FMT
+ * straight to it instead of the candidate walk.
+ */
+static bool resume_format(struct v4l2_mplane_source* s, const struct axon_cached_format* c,
+                          struct v4l2_format* fmt, bool set)
 {
-    if (!s)
+    memset(fmt, 0, sizeof(*fmt));
+    fmt->type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    if (set) {
+        fmt->fmt.pix_mp.width       = c->width;
+        fmt->fmt.pix_mp.height      = c->height;
+        fmt->fmt.pix_mp.pixelformat = c->fourcc;
+        fmt->fmt.pix_mp.field       = c->field;
+    }
+    if (ioctl(s->fd, set ? VIDIOC_S_FMT : VIDIOC_G_FMT, fmt) < 0)
         return false;
+    return format_matches(c, fmt) && c->num_buffers <= BUFFER_COUNT;
+}
 
+static bool open_device(struct v4l2_mplane_source* s, bool use_cache)
+{
     s->fd = open(s->device_path, O_RDWR | O_NONBLOCK);
     if (s->fd < 0) {
         blog(LOG_ERROR, "[axon] Failed to open %s: %s", s->device_path, strerror(errno));
@@ -281,7 +1557,8 @@ static bool start_device(struct v4l2_mplane_source* s)
     s->pcm_handle    = NULL;
     s->audio_running = false;
 
-    if (snd_pcm_open(&s->pcm_handle, s->alsa_device, SND_PCM_STREAM_CAPTURE, 0) < 0) {
+    if (snd_pcm_open(&s->pcm_handle, s->alsa_device, SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK) <
+        0) {
         blog(LOG_ERROR, "Failed to open ALSA device");
         s->pcm_handle = NULL;
     } else {
@@ -294,19 +1571,116 @@ static bool start_device(struct v4l2_mplane_source* s)
         snd_pcm_prepare(s->pcm_handle);
         snd_pcm_start(s->pcm_handle);
 
-        s->audio_running = true;
-        pthread_create(&s->audio_thread, NULL, audio_thread_fn, s);
+        if (!start_audio(s)) {
+            stop_audio(s);
+            snd_pcm_close(s->pcm_handle);
+            s->pcm_handle = NULL;
+        }
+    }
+
+    if (axon_controls_enumerate(&s->controls, s->fd) > 0) {
+        obs_data_t* settings = obs_source_get_settings(s->source);
+        axon_controls_load_settings(&s->controls, settings);
+        obs_data_release(settings);
+    }
+
+    if (s->lut_path[0] && !s->async) {
+        s->lut = axon_lut_acquire(s->lut_path);
+        if (!s->lut)
+            blog(LOG_WARNING, "[axon] Colour LUT disabled for %s", s->device_path);
+    }
+
+    /* the converter knows nothing of rotation or LUTs, so those sources convert on the CPU */
+    bool use_m2m = s->m2m_path[0] && !s->encoder_path[0] && !s->async;
+    if (use_m2m && (!axon_transform_is_identity(&s->transform) || s->lut)) {
+        blog(LOG_INFO, "[axon] Rotation/mirroring or LUT set, not using %s for %s", s->m2m_path,
+             s->device_path);
+        use_m2m = false;
+    }
+    if (use_m2m && s->deep_color) {
+        blog(LOG_INFO, "[axon] 10-bit capture requested, not using %s for %s", s->m2m_path,
+             s->device_path);
+        use_m2m = false;
+    }
+    uint32_t fourcc = use_m2m ? open_m2m(s) : V4L2_PIX_FMT_NV12;
+
+    /* a format that worked before is tried first; any mismatch negotiates in full */
+    struct v4l2_format        fmt;
+    struct axon_cached_format cached;
+    bool known = format_key(s, fourcc) && use_cache &&
+                 axon_formats_lookup(s->format_key, &cached);
+    s->format_cached = known && resume_format(s, &cached, &fmt, false);
+    if (!s->format_cached && s->media_setup)
+        axon_media_setup(s->device_path, &s->width, &s->height);
+    if (!s->format_cached && known)
+        s->format_cached = resume_format(s, &cached, &fmt, true);
+    if (s->format_cached) {
+        blog(LOG_INFO, "[axon] Using the cached format for %s", s->device_path);
+        if (!read_fields(s, &fmt)) {
+            close_m2m(s);
+            close(s->fd);
+            s->fd = -1;
+            return false;
+        }
+        fourcc = fmt.fmt.pix_mp.pixelformat;
+    } else if (known) {
+        blog(LOG_INFO, "[axon] Cached format for %s no longer applies, negotiating",
+             s->device_path);
+    }
+
+    /* 10-bit candidates first; the deinterlacer only reads 8-bit, so interlaced falls through */
+    uint32_t wanted[3];
+    int      num_wanted = 0;
+    if (s->deep_color && !use_m2m) {
+        for (size_t i = 0; i < sizeof(deep_formats) / sizeof(deep_formats[0]); i++)
+            wanted[num_wanted++] = deep_formats[i];
     }
+    wanted[num_wanted++] = fourcc;
 
-    struct v4l2_format fmt;
-    memset(&fmt, 0, sizeof(fmt));
-    fmt.type                   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    fmt.fmt.pix_mp.width       = s->width;
-    fmt.fmt.pix_mp.height      = s->height;
-    fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_NV12;
+    for (int i = 0; i < num_wanted && !s->format_cached; i++) {
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type                   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        fmt.fmt.pix_mp.width       = s->width;
+        fmt.fmt.pix_mp.height      = s->height;
+        fmt.fmt.pix_mp.pixelformat = wanted[i];
 
-    if (ioctl(s->fd, VIDIOC_S_FMT, &fmt) < 0) {
-        blog(LOG_WARNING, "[axon] VIDIOC_S_FMT failed: %s", strerror(errno));
+        if (ioctl(s->fd, VIDIOC_S_FMT, &fmt) < 0) {
+            blog(LOG_WARNING, "[axon] VIDIOC_S_FMT failed: %s", strerror(errno));
+        }
+        if (!read_fields(s, &fmt)) {
+            close_m2m(s);
+            close(s->fd);
+            s->fd = -1;
+            return false;
+        }
+        if (i == num_wanted - 1 || fmt.fmt.pix_mp.pixelformat != wanted[i])
+            continue;
+        if (s->interlaced && !s->async) {
+            blog(LOG_INFO, "[axon] %s is interlaced, capturing 8-bit to deinterlace",
+                 s->device_path);
+            continue;
+        }
+        fourcc = wanted[i];
+        break;
+    }
+    s->capture_fourcc = fmt.fmt.pix_mp.pixelformat ? fmt.fmt.pix_mp.pixelformat : fourcc;
+    s->colorspace     = fmt.fmt.pix_mp.colorspace;
+    s->ycbcr_enc      = fmt.fmt.pix_mp.ycbcr_enc;
+    s->xfer_func      = fmt.fmt.pix_mp.xfer_func;
+    s->quantization   = fmt.fmt.pix_mp.quantization;
+    s->convert_format = capture_format(s);
+    if (s->m2m[0] && s->capture_fourcc != s->m2m_input.fourcc)
+        close_m2m(s);
+
+    /* the converter would weave the fields; NV12 can be deinterlaced on the CPU instead */
+    if (s->m2m[0] && s->interlaced) {
+        if (is_nv12(s->capture_fourcc)) {
+            blog(LOG_INFO, "[axon] %s is interlaced, not using %s", s->device_path, s->m2m_path);
+            close_m2m(s);
+        } else {
+            blog(LOG_WARNING, "[axon] %s is interlaced, fields are woven by %s", s->device_path,
+                 s->m2m_path);
+        }
     }
 
     s->width      = (int) fmt.fmt.pix_mp.width;
@@ -325,7 +1699,7 @@ static bool start_device(struct v4l2_mplane_source* s)
 
     struct v4l2_requestbuffers req;
     memset(&req, 0, sizeof(req));
-    req.count  = BUFFER_COUNT;
+    req.count  = s->format_cached ? cached.num_buffers : BUFFER_COUNT;
     req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     req.memory = V4L2_MEMORY_MMAP;
 
@@ -343,6 +1717,7 @@ static bool start_device(struct v4l2_mplane_source* s)
     }
     s->num_buffers = (int) req.count;
     zero_buffers(s);
+    s->requests_active = s->use_requests && open_requests(s, req.capabilities);
 
     for (int i = 0; i < s->num_buffers; i++) {
         struct v4l2_buffer buf;
@@ -397,30 +1772,22 @@ static bool start_device(struct v4l2_mplane_source* s)
             s->buffers[i].start[0]  = mapped;
             s->buffers[i].length[0] = plen;
 
+            /* packed formats only ever go to the M2M converter, as one plane */
             size_t y_bytes = (size_t) s->y_stride * (size_t) s->height;
-            if (y_bytes >= plen) {
+            if (cpu_format(s->capture_fourcc) && y_bytes >= plen) {
                 blog(LOG_ERROR, "[axon] NV12 split exceeds buffer: total=%zu y=%zu", plen, y_bytes);
                 free_mapped_buffers(s);
                 close(s->fd);
                 s->fd = -1;
                 return false;
             }
-            s->buffers[i].start[1]  = (uint8_t*) mapped + y_bytes;
-            s->buffers[i].length[1] = plen - y_bytes;
-        }
-
-        struct v4l2_buffer qbuf;
-        struct v4l2_plane  qplanes[VIDEO_MAX_PLANES];
-        memset(&qbuf, 0, sizeof(qbuf));
-        memset(qplanes, 0, sizeof(qplanes));
-        qbuf.type     = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-        qbuf.memory   = V4L2_MEMORY_MMAP;
-        qbuf.index    = i;
-        qbuf.m.planes = qplanes;
-        qbuf.length   = (unsigned int) ((s->num_planes >= 2) ? 2 : 1);
-
-        if (ioctl(s->fd, VIDIOC_QBUF, &qbuf) < 0) {
-            blog(LOG_ERROR, "[axon] VIDIOC_QBUF failed: %s", strerror(errno));
+            if (cpu_format(s->capture_fourcc)) {
+                s->buffers[i].start[1]  = (uint8_t*) mapped + y_bytes;
+                s->buffers[i].length[1] = plen - y_bytes;
+            }
+        }
+
+        if (!queue_buffer(s, i)) {
             free_mapped_buffers(s);
             close(s->fd);
             s->fd = -1;
@@ -428,6 +1795,25 @@ static bool start_device(struct v4l2_mplane_source* s)
         }
     }
 
+    if (s->m2m[0] && !export_dmabufs(s))
+        close_m2m(s);
+    s->m2m_active = s->m2m[0] != NULL;
+    if (!s->m2m_active && !cpu_format(s->capture_fourcc)) {
+        blog(LOG_ERROR, "[axon] %s provides neither NV12 nor P010/NV15", s->device_path);
+        free_mapped_buffers(s);
+        close(s->fd);
+        s->fd = -1;
+        return false;
+    }
+
+    if (s->encoder_path[0] && !open_encoder(s)) {
+        blog(LOG_WARNING, "[axon] Encoder %s unavailable, showing %s in OBS instead",
+             s->encoder_path, s->device_path);
+    }
+
+    /* saved control values are in place before the first frame */
+    axon_controls_apply(&s->controls, s->fd, -1);
+
     enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     if (ioctl(s->fd, VIDIOC_STREAMON, &type) < 0) {
         blog(LOG_ERROR, "[axon] VIDIOC_STREAMON failed: %s", strerror(errno));
@@ -437,7 +1823,29 @@ static bool start_device(struct v4l2_mplane_source* s)
         return false;
     }
 
-    if (!alloc_rgb_and_texture(s)) {
+    if (s->async && s->capture_fourcc == V4L2_PIX_FMT_NV15) {
+        size_t samples = (size_t) s->width * (size_t) s->height +
+                         (size_t) ((s->width + 1) & ~1) * (size_t) ((s->height + 1) / 2);
+        s->p010_stage  = (uint16_t*) bzalloc(samples * sizeof(uint16_t));
+    }
+    if (s->async && s->interlaced)
+        blog(LOG_WARNING, "[axon] Async output is not deinterlaced (%s)", s->device_path);
+
+    if (!s->async && !alloc_rgb_and_texture(s)) {
+        stop_streaming(s->fd);
+        free_mapped_buffers(s);
+        close(s->fd);
+        s->fd = -1;
+        return false;
+    }
+
+    s->pending_count = 0;
+    s->convert_index = -1;
+    s->have_sequence = false;
+    axon_overload_init(&s->overload);
+    s->capture_failed = false;
+    s->video_watch    = axon_loop_add(s->fd, POLLIN, capture_ready, s);
+    if (!s->video_watch) {
         stop_streaming(s->fd);
         free_mapped_buffers(s);
         close(s->fd);
@@ -445,9 +1853,56 @@ static bool start_device(struct v4l2_mplane_source* s)
         return false;
     }
 
-    blog(LOG_INFO, "[axon] Negotiated format: %dx%d, planes=%d, y_stride=%d, uv_stride=%d",
-         s->width, s->height, s->num_planes, s->y_stride, s->uv_stride);
+    blog(LOG_INFO, "[axon] Negotiated format: %.4s %dx%d, planes=%d, y_stride=%d, uv_stride=%d%s",
+         (const char*) &s->capture_fourcc, s->width, s->height, s->num_planes, s->y_stride,
+         s->uv_stride, s->m2m_active ? ", M2M conversion" : "");
+
+    memset(&s->format, 0, sizeof(s->format));
+    s->format.fourcc      = fmt.fmt.pix_mp.pixelformat;
+    s->format.width       = fmt.fmt.pix_mp.width;
+    s->format.height      = fmt.fmt.pix_mp.height;
+    s->format.field       = fmt.fmt.pix_mp.field;
+    s->format.num_planes  = fmt.fmt.pix_mp.num_planes;
+    s->format.num_buffers = (uint32_t) s->num_buffers;
+    for (int p = 0; p < s->num_planes && p < AXON_FORMAT_PLANES; p++) {
+        s->format.bytesperline[p] = fmt.fmt.pix_mp.plane_fmt[p].bytesperline;
+        s->format.sizeimage[p]    = fmt.fmt.pix_mp.plane_fmt[p].sizeimage;
+    }
+    return true;
+}
+
+static void stop_device(struct v4l2_mplane_source* s);
 
+/*
+ * open_device, remembering what worked. A cached format that is accepted but
+ * then does not start (the media graph was reset, buffers or streaming
+ * refused) is dropped and the device negotiated from scratch, media setup
+ * included, so a stale cache never shows up as a failed start.
+ */
+static bool start_device(struct v4l2_mplane_source* s)
+{
+    if (!s)
+        return false;
+
+    int width        = s->width;
+    int height       = s->height;
+    s->format_key[0] = 0;
+    s->format_cached = false;
+    if (!open_device(s, true)) {
+        if (!s->format_cached)
+            return false;
+        blog(LOG_WARNING, "[axon] Cached format for %s did not start, negotiating again",
+             s->device_path);
+        axon_formats_forget(s->format_key);
+        stop_device(s);
+        s->width         = width;
+        s->height        = height;
+        s->format_cached = false;
+        if (!open_device(s, false))
+            return false;
+    }
+    if (s->format_key[0] && s->format.num_planes <= AXON_FORMAT_PLANES)
+        axon_formats_store(s->format_key, &s->format);
     return true;
 }
 
@@ -456,10 +1911,8 @@ static void stop_device(struct v4l2_mplane_source* s)
     if (!s)
         return;
 
-    if (s->audio_running) {
-        s->audio_running = false;
-        pthread_join(s->audio_thread, NULL);
-    }
+    stop_audio(s);
+    stop_capture(s);
 
     if (s->pcm_handle) {
         snd_pcm_drop(s->pcm_handle);
@@ -467,8 +1920,14 @@ static void stop_device(struct v4l2_mplane_source* s)
         s->pcm_handle = NULL;
     }
 
+    close_encoder(s);
     stop_streaming(s->fd);
     free_mapped_buffers(s);
+    close_requests(s);
+    close_m2m(s);
+    axon_controls_clear(&s->controls);
+    axon_lut_release(s->lut);
+    s->lut = NULL;
 
     if (s->fd >= 0) {
         close(s->fd);
@@ -482,27 +1941,328 @@ static const char* mplane_get_name(void* unused)
     return "V4L2 axon camera";
 }
 
+static const char* mplane_async_get_name(void* unused)
+{
+    (void) unused;
+    return "V4L2 axon camera (async, 10-bit passthrough)";
+}
+
 static uint32_t mplane_width(void* data)
 {
-    return ((struct v4l2_mplane_source*) data)->width;
+    return (uint32_t) output_width((struct v4l2_mplane_source*) data);
 }
 
 static uint32_t mplane_height(void* data)
 {
-    return ((struct v4l2_mplane_source*) data)->height;
+    return (uint32_t) output_height((struct v4l2_mplane_source*) data);
 }
 
-static void* mplane_create(obs_data_t* settings, obs_source_t* source)
+static struct axon_transform read_transform(obs_data_t* settings)
+{
+    struct axon_transform t;
+    t.rotation = (int) (obs_data_get_int(settings, "rotation") / 90) & 3;
+    t.hflip    = obs_data_get_bool(settings, "flip_horizontal");
+    t.vflip    = obs_data_get_bool(settings, "flip_vertical");
+    return t;
+}
+
+/* settings that take effect without restarting the device */
+static void apply_runtime_settings(struct v4l2_mplane_source* s, obs_data_t* settings)
+{
+    s->drop_late     = obs_data_get_bool(settings, "drop_late");
+    s->keep_warm     = obs_data_get_bool(settings, "keep_warm");
+    s->staged_upload = obs_data_get_bool(settings, "staged_upload");
+    s->media_setup   = obs_data_get_bool(settings, "media_setup");
+    s->use_requests  = obs_data_get_bool(settings, "request_controls");
+    axon_controls_load_settings(&s->controls, settings);
+
+    s->overload.mode =
+        axon_overload_mode_from_string(obs_data_get_string(settings, "overload_mode"));
+    s->overload.queue_threshold = (int) obs_data_get_int(settings, "overload_queue_depth");
+    s->overload.load_percent    = (int) obs_data_get_int(settings, "overload_load_percent");
+
+    const char* latency = obs_data_get_string(settings, "latency_mode");
+    int         mode    = LATENCY_MODE_OFF;
+    if (latency && !strcmp(latency, "measure"))
+        mode = LATENCY_MODE_MEASURE;
+    else if (latency && !strcmp(latency, "inject"))
+        mode = LATENCY_MODE_INJECT;
+    if (mode != s->latency_mode) {
+        s->glass_latency_ms        = -1.0;
+        s->latency_decode_failures = 0;
+    }
+    s->latency_mode        = mode;
+    s->latency_row_percent = (int) obs_data_get_int(settings, "latency_row_percent");
+
+    const char* preview = obs_data_get_string(settings, "preview_quality");
+    if (preview && !strcmp(preview, "quarter"))
+        s->preview_shift = 2;
+    else if (preview && !strcmp(preview, "half"))
+        s->preview_shift = 1;
+    else
+        s->preview_shift = 0;
+
+    s->deinterlace =
+        axon_deinterlace_mode_from_string(obs_data_get_string(settings, "deinterlace"));
+
+    const char* transfer = obs_data_get_string(settings, "bt2020_transfer");
+    s->bt2020_hlg        = transfer && !strcmp(transfer, "hlg");
+
+    const char* group = obs_data_get_string(settings, "sync_group");
+    if (strcmp(s->sync_group, group ? group : "") != 0) {
+        axon_sync_leave(s->sync);
+        snprintf(s->sync_group, sizeof(s->sync_group), "%s", group ? group : "");
+        s->sync = axon_sync_join(s->sync_group);
+    }
+    s->sync_max_latency_ns =
+        (uint64_t) obs_data_get_int(settings, "sync_max_latency_ms") * 1000000ULL;
+}
+
+/* counters are read without locking; a scrape may be a frame behind */
+static void fill_stats(void* data, struct axon_capture_stats* stats)
+{
+    struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) data;
+
+    memset(stats, 0, sizeof(*stats));
+    snprintf(stats->device_path, sizeof(stats->device_path), "%s", s->device_path);
+    snprintf(stats->name, sizeof(stats->name), "%s", obs_source_get_name(s->source));
+    stats->frames_captured      = s->frames_captured;
+    stats->frames_converted     = s->frames_converted;
+    stats->frames_dropped       = s->frames_dropped;
+    stats->frames_late          = s->frames_late;
+    stats->frames_m2m_failed    = s->frames_m2m_failed;
+    stats->frames_shed          = s->overload.frames_shed;
+    stats->audio_xruns          = s->audio_xruns;
+    stats->overload_transitions = s->overload.transitions;
+    stats->queue_depth          = s->pending_count + (s->convert_busy ? 1 : 0);
+    stats->overloaded           = s->overload.shedding;
+    stats->convert_ms           = (double) s->convert_ns_avg / 1e6;
+    stats->latency_ms           = (double) s->latency_ns_avg / 1e6;
+    stats->glass_latency_ms     = s->latency_mode != LATENCY_MODE_OFF ? s->glass_latency_ms : -1.0;
+    stats->convert_seconds      = s->convert_hist;
+    stats->reconfigure_seconds  = s->reconfigure_hist;
+    stats->control_frame        = s->control_frame;
+}
+
+/*
+ * Device tasks waiting for a pool worker, oldest first. At most one per
+ * source is queued at a time, and fewer run at once than there are workers
+ * so a starting camera never holds up conversions of the running ones.
+ */
+static struct {
+    pthread_mutex_t            lock;
+    pthread_cond_t             idle;
+    int                        running;
+    struct v4l2_mplane_source* head;
+    struct v4l2_mplane_source* tail;
+} devices = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, NULL, NULL};
+
+/* io_lock held: start the device, or leave nothing half open if it will not start */
+static bool bring_up(struct v4l2_mplane_source* s)
+{
+    uint64_t start_ns = os_gettime_ns();
+    if (!start_device(s)) {
+        stop_device(s);
+        release_frames(s);
+        return false;
+    }
+    axon_histogram_observe(&s->reconfigure_hist, (double) (os_gettime_ns() - start_ns) / 1e9);
+    return true;
+}
+
+/* io_lock held */
+static void shut_down(struct v4l2_mplane_source* s)
+{
+    /* once stopped no conversion is left to swap, so frame_lock is not needed */
+    stop_device(s);
+    release_frames(s);
+    s->new_frame = false;
+}
+
+/* async sources: a flat grey frame at the source size while the device starts */
+static void output_placeholder(struct v4l2_mplane_source* s)
+{
+    uint32_t w       = (uint32_t) output_width(s);
+    uint32_t h       = (uint32_t) output_height(s);
+    uint32_t uv_w    = (w + 1) & ~1u;
+    size_t   y_size  = (size_t) w * h;
+    size_t   uv_size = (size_t) uv_w * ((h + 1) / 2);
+    uint8_t* data    = (uint8_t*) bmalloc(y_size + uv_size);
+
+    memset(data, PLACEHOLDER_LUMA, y_size);
+    memset(data + y_size, 128, uv_size);
+
+    struct obs_source_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.width       = w;
+    frame.height      = h;
+    frame.timestamp   = os_gettime_ns();
+    frame.format      = VIDEO_FORMAT_NV12;
+    frame.data[0]     = data;
+    frame.data[1]     = data + y_size;
+    frame.linesize[0] = w;
+    frame.linesize[1] = uv_w;
+    video_format_get_parameters_for_format(VIDEO_CS_601, VIDEO_RANGE_PARTIAL, frame.format,
+                                           frame.color_matrix, frame.color_range_min,
+                                           frame.color_range_max);
+    obs_source_output_video(s->source, &frame);
+    bfree(data);
+}
+
+static void device_task(void* arg);
+
+static void* device_thread_fn(void* arg)
+{
+    os_set_thread_name("axon-device");
+    device_task(arg);
+    return NULL;
+}
+
+/*
+ * Opening a device can block for seconds. A pool with a single worker
+ * would stop converting every other source meanwhile, so there the task
+ * gets a short-lived thread of its own.
+ */
+static void run_device_task(struct v4l2_mplane_source* s)
+{
+    if (axon_pool_num_threads() <= 1) {
+        pthread_t      thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        bool started = pthread_create(&thread, &attr, device_thread_fn, s) == 0;
+        pthread_attr_destroy(&attr);
+        if (started)
+            return;
+        blog(LOG_WARNING, "[axon] Cannot start a device thread, opening on the pool");
+    }
+    if (!axon_pool_submit(device_task, s, AXON_PRIO_BACKGROUND))
+        device_task(s);
+}
+
+/* pool task: open or close the device to match shown/keep_warm */
+static void device_task(void* arg)
+{
+    struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) arg;
+
+    /* from here on a show/hide queues another task rather than being missed */
+    pthread_mutex_lock(&devices.lock);
+    s->device_queued = false;
+    pthread_mutex_unlock(&devices.lock);
+
+    pthread_mutex_lock(&s->io_lock);
+    bool wanted = s->shown || s->keep_warm;
+    if (wanted && s->fd < 0) {
+        s->capture_restarts = 0;
+        if (s->async)
+            output_placeholder(s);
+        if (!bring_up(s))
+            blog(LOG_ERROR, "[axon] Could not start %s, retrying when next shown",
+                 s->device_path);
+    } else if (wanted && s->capture_failed) {
+        shut_down(s);
+        if (++s->capture_restarts > CAPTURE_MAX_RESTARTS) {
+            blog(LOG_ERROR, "[axon] %s keeps failing, stopped until it is shown again",
+                 s->device_path);
+        } else if (!bring_up(s)) {
+            blog(LOG_ERROR, "[axon] Could not restart %s, retrying when next shown",
+                 s->device_path);
+        }
+        if (s->fd < 0 && s->async)
+            obs_source_output_video(s->source, NULL);
+    } else if (!wanted && s->fd >= 0) {
+        blog(LOG_INFO, "[axon] %s no longer shown, closing it", s->device_path);
+        shut_down(s);
+        if (s->async)
+            obs_source_output_video(s->source, NULL);
+    }
+    pthread_mutex_unlock(&s->io_lock);
+
+    /* hand the slot straight to the next waiting source */
+    pthread_mutex_lock(&devices.lock);
+    struct v4l2_mplane_source* next = devices.head;
+    if (next) {
+        devices.head = next->device_next;
+        if (!devices.head)
+            devices.tail = NULL;
+        next->device_next = NULL;
+    } else {
+        devices.running--;
+    }
+    s->device_tasks--;
+    pthread_cond_broadcast(&devices.idle);
+    pthread_mutex_unlock(&devices.lock);
+
+    if (next)
+        run_device_task(next);
+}
+
+/* one pool worker is always left for conversions; off the pool, devices open one at a time */
+static void request_device_state(struct v4l2_mplane_source* s)
+{
+    int  threads = axon_pool_num_threads();
+    int  limit   = threads > 1 ? threads - 1 : 1;
+    bool submit  = false;
+
+    pthread_mutex_lock(&devices.lock);
+    if (!s->device_queued) {
+        s->device_queued = true;
+        s->device_tasks++;
+        if (devices.running < limit) {
+            devices.running++;
+            submit = true;
+        } else {
+            s->device_next = NULL;
+            if (devices.tail)
+                devices.tail->device_next = s;
+            else
+                devices.head = s;
+            devices.tail = s;
+        }
+    }
+    pthread_mutex_unlock(&devices.lock);
+
+    if (submit)
+        run_device_task(s);
+}
+
+/* destroy: drop a task still waiting for a slot and wait out the running ones */
+static void cancel_device_tasks(struct v4l2_mplane_source* s)
+{
+    pthread_mutex_lock(&devices.lock);
+    struct v4l2_mplane_source* prev = NULL;
+    for (struct v4l2_mplane_source* q = devices.head; q; prev = q, q = q->device_next) {
+        if (q != s)
+            continue;
+        if (prev)
+            prev->device_next = q->device_next;
+        else
+            devices.head = q->device_next;
+        if (devices.tail == q)
+            devices.tail = prev;
+        s->device_queued = false;
+        s->device_tasks--;
+        break;
+    }
+    while (s->device_tasks > 0)
+        pthread_cond_wait(&devices.idle, &devices.lock);
+    pthread_mutex_unlock(&devices.lock);
+}
+
+static void* create_source(obs_data_t* settings, obs_source_t* source, bool async)
 {
     struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) bzalloc(sizeof(*s));
     if (!s)
         return NULL;
 
     s->source      = source;
+    s->async       = async;
     s->fd          = -1;
-    s->texture     = NULL;
+    s->ring_draw   = -1;
+    s->ring_staged = -1;
     s->rgb_front   = NULL;
     s->rgb_back    = NULL;
+    s->rgb_upload  = NULL;
     s->new_frame   = false;
     s->y_stride    = 0;
     s->uv_stride   = 0;
@@ -510,10 +2270,28 @@ static void* mplane_create(obs_data_t* settings, obs_source_t* source)
     s->num_buffers = 0;
     pthread_mutex_init(&s->frame_lock, NULL);
     pthread_mutex_init(&s->io_lock, NULL);
-    s->reconfiguring = false;
+    pthread_mutex_init(&s->capture_lock, NULL);
+    pthread_cond_init(&s->capture_cond, NULL);
+    axon_controls_init(&s->controls);
+    for (int i = 0; i < BUFFER_COUNT; i++)
+        s->request_fds[i] = -1;
+    s->control_frame = -1;
+    s->convert_job.fn   = convert_stripe;
+    s->convert_job.done = convert_done;
+    s->convert_job.arg  = s;
+    s->glass_latency_ms = -1.0;
+    axon_histogram_init(&s->convert_hist, convert_buckets,
+                        (int) (sizeof(convert_buckets) / sizeof(convert_buckets[0])));
+    axon_histogram_init(&s->reconfigure_hist, reconfigure_buckets,
+                        (int) (sizeof(reconfigure_buckets) / sizeof(reconfigure_buckets[0])));
 
     const char* dev     = obs_data_get_string(settings, "device_path");
     const char* res_str = obs_data_get_string(settings, "resolution");
+    const char* m2m     = obs_data_get_string(settings, "m2m_device");
+    const char* enc     = obs_data_get_string(settings, "encoder_device");
+    const char* enc_dir = obs_data_get_string(settings, "encode_dir");
+    const char* lut     = obs_data_get_string(settings, "lut_path");
+    apply_runtime_settings(s, settings);
 
     int w = 640, h = 480;
     // int w = 1280, h = 720;
@@ -530,17 +2308,29 @@ static void* mplane_create(obs_data_t* settings, obs_source_t* source)
     s->width  = w;
     s->height = h;
     snprintf(s->device_path, sizeof(s->device_path), "%s", (dev && dev[0]) ? dev : "/dev/video11");
+    snprintf(s->m2m_path, sizeof(s->m2m_path), "%s", m2m ? m2m : "");
+    snprintf(s->encoder_path, sizeof(s->encoder_path), "%s", enc ? enc : "");
+    snprintf(s->encode_dir, sizeof(s->encode_dir), "%s", enc_dir ? enc_dir : "");
+    snprintf(s->lut_path, sizeof(s->lut_path), "%s", lut ? lut : "");
+    s->transform  = read_transform(settings);
+    s->deep_color = obs_data_get_int(settings, "bit_depth") == 10;
+
+    /* loading a scene collection opens nothing; the first show does */
+    if (s->keep_warm)
+        request_device_state(s);
+
+    axon_metrics_register(s, fill_stats);
+    return s;
+}
 
-    if (!start_device(s)) {
-        destroy_texture(s);
-        destroy_rgb(s);
-        pthread_mutex_destroy(&s->io_lock);
-        pthread_mutex_destroy(&s->frame_lock);
-        bfree(s);
-        return NULL;
-    }
+static void* mplane_create(obs_data_t* settings, obs_source_t* source)
+{
+    return create_source(settings, source, false);
+}
 
-    return s;
+static void* mplane_async_create(obs_data_t* settings, obs_source_t* source)
+{
+    return create_source(settings, source, true);
 }
 
 static void mplane_update(void* data, obs_data_t* settings)
@@ -551,6 +2341,11 @@ static void mplane_update(void* data, obs_data_t* settings)
 
     const char* dev     = obs_data_get_string(settings, "device_path");
     const char* res_str = obs_data_get_string(settings, "resolution");
+    const char* m2m     = obs_data_get_string(settings, "m2m_device");
+    const char* enc     = obs_data_get_string(settings, "encoder_device");
+    const char* enc_dir = obs_data_get_string(settings, "encode_dir");
+    const char* lut     = obs_data_get_string(settings, "lut_path");
+    apply_runtime_settings(s, settings);
 
     int w = s->width;
     int h = s->height;
@@ -572,150 +2367,287 @@ static void mplane_update(void* data, obs_data_t* settings)
     const char* dev_safe    = (dev && dev[0]) ? dev : "/dev/video11";
     bool        dev_changed = strcmp(s->device_path, dev_safe) != 0;
     bool        res_changed = (w != s->width) || (h != s->height);
-
-    if (!dev_changed && !res_changed) {
-        blog(LOG_INFO, "[axon] Requested format %dx%d NV12 not available", s->width, s->height);
+    bool        m2m_changed = strcmp(s->m2m_path, m2m ? m2m : "") != 0;
+    bool        enc_changed = strcmp(s->encoder_path, enc ? enc : "") != 0 ||
+                              strcmp(s->encode_dir, enc_dir ? enc_dir : "") != 0;
+    bool        lut_changed = strcmp(s->lut_path, lut ? lut : "") != 0;
+    bool        deep_color  = obs_data_get_int(settings, "bit_depth") == 10;
+    bool        fmt_changed = deep_color != s->deep_color;
+
+    /* the output size and the M2M choice both depend on the transform */
+    struct axon_transform transform     = read_transform(settings);
+    bool                  xform_changed = transform.rotation != s->transform.rotation ||
+                                          transform.hflip != s->transform.hflip ||
+                                          transform.vflip != s->transform.vflip;
+
+    /* keep_warm may have changed whether a hidden source should be running */
+    bool running = s->fd >= 0;
+    bool wanted  = s->shown || s->keep_warm;
+
+    if (!dev_changed && !res_changed && !m2m_changed && !enc_changed && !xform_changed &&
+        !lut_changed && !fmt_changed && running == wanted)
         return;
-    }
-
-    s->reconfiguring = true;
 
     pthread_mutex_lock(&s->io_lock);
-    pthread_mutex_lock(&s->frame_lock);
+    running = s->fd >= 0;
+    wanted  = s->shown || s->keep_warm;
 
     stop_device(s);
-    os_sleep_ms(100);
-    destroy_texture(s);
-    destroy_rgb(s);
+    if (running)
+        os_sleep_ms(100);
+    release_frames(s);
 
     snprintf(s->device_path, sizeof(s->device_path), "%s", dev_safe);
-    s->width  = w;
-    s->height = h;
-
-    bool started = start_device(s);
-    if (started && s->rgb_front) {
-        memset(s->rgb_front, 0, (size_t) s->width * (size_t) s->height * 4);
-        s->new_frame = false;
+    snprintf(s->m2m_path, sizeof(s->m2m_path), "%s", m2m ? m2m : "");
+    snprintf(s->encoder_path, sizeof(s->encoder_path), "%s", enc ? enc : "");
+    snprintf(s->encode_dir, sizeof(s->encode_dir), "%s", enc_dir ? enc_dir : "");
+    snprintf(s->lut_path, sizeof(s->lut_path), "%s", lut ? lut : "");
+    s->transform  = transform;
+    s->deep_color = deep_color;
+    s->width     = w;
+    s->height    = h;
+
+    /* a hidden source only records the settings, they apply on the next show */
+    bool started = !wanted || bring_up(s);
+    if (started && wanted)
         blog(LOG_INFO, "[axon] Reconfigured successfully to %dx%d", s->width, s->height);
-    } else {
+    else if (!started)
         blog(LOG_ERROR, "[axon] Reconfigure failed");
-    }
 
-    pthread_mutex_unlock(&s->frame_lock);
     pthread_mutex_unlock(&s->io_lock);
-
-    s->reconfiguring = false;
-
-    if (!started) {
-        blog(LOG_ERROR, "[axon] Reconfigure failed");
-    }
 }
 
-static void mplane_tick(void* data, float seconds)
+/* graphics thread, on the first tick the source is visible in preview or program */
+static void mplane_show(void* data)
 {
-    (void) seconds;
     struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) data;
-    if (!s)
-        return;
-    if (s->reconfiguring) {
-        os_sleep_ms(5);
-        return;
-    }
-    if (s->fd < 0)
-        return;
-
-    struct v4l2_buffer buf;
-    struct v4l2_plane  planes[VIDEO_MAX_PLANES];
-    memset(&buf, 0, sizeof(buf));
-    memset(planes, 0, sizeof(planes));
+    s->shown                     = true;
+    request_device_state(s);
+}
 
-    buf.type     = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    buf.memory   = V4L2_MEMORY_MMAP;
-    buf.m.planes = planes;
-    buf.length   = VIDEO_MAX_PLANES;
+static void mplane_hide(void* data)
+{
+    struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) data;
+    s->shown                     = false;
+    request_device_state(s);
+}
 
-    if (ioctl(s->fd, VIDIOC_DQBUF, &buf) < 0) {
-        if (errno == EAGAIN) {
+/* graphics thread: flat grey at the source size until the first frame is drawn */
+static void draw_placeholder(struct v4l2_mplane_source* s, gs_effect_t* effect)
+{
+    if (!s->placeholder) {
+        static const uint8_t grey[4] = {PLACEHOLDER_GREY, PLACEHOLDER_GREY, PLACEHOLDER_GREY, 255};
+        const uint8_t*       data[1] = {grey};
+        s->placeholder               = gs_texture_create(1, 1, GS_BGRA, 1, data, 0);
+        if (!s->placeholder)
             return;
-        }
-        blog(LOG_DEBUG, "[axon] DQBUF error: %s", strerror(errno));
-        return;
     }
+    gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), s->placeholder);
+    gs_draw_sprite(s->placeholder, 0, (uint32_t) output_width(s), (uint32_t) output_height(s));
+}
 
-    int idx = buf.index;
-    if (idx >= 0 && idx < s->num_buffers) {
-        const uint8_t* y_plane  = (const uint8_t*) s->buffers[idx].start[0];
-        const uint8_t* uv_plane = NULL;
-
-        if (s->buffers[idx].start[1]) {
-            uv_plane = (const uint8_t*) s->buffers[idx].start[1];
-        } else if (y_plane) {
-            uv_plane = y_plane + (size_t) s->y_stride * (size_t) s->height;
-        }
+/* graphics thread: (re)size a ring slot for frames converted at reduced resolution */
+static gs_texture_t* ring_texture(struct v4l2_mplane_source* s, int slot, int shift)
+{
+    if (s->ring[slot] && s->ring_shift[slot] == shift)
+        return s->ring[slot];
+
+    gs_texture_destroy(s->ring[slot]);
+    s->ring[slot]       = gs_texture_create(output_width(s) >> shift, output_height(s) >> shift,
+                                            GS_BGRA, 1, NULL, GS_DYNAMIC);
+    s->ring_shift[slot] = shift;
+    return s->ring[slot];
+}
 
-        if (y_plane && uv_plane && s->rgb_back) {
-            nv12_to_bgra(s->rgb_back, y_plane, uv_plane, s->width, s->height, s->y_stride,
-                         s->uv_stride);
-            pthread_mutex_lock(&s->frame_lock);
-            uint8_t* tmp = s->rgb_front;
-            s->rgb_front = s->rgb_back;
-            s->rgb_back  = tmp;
-            s->new_frame = true;
-            pthread_mutex_unlock(&s->frame_lock);
+/*
+ * graphics thread: draw the slot closest to the group's presentation time.
+ * The next slot to be written and one still uploading are never candidates,
+ * and the picture never steps back in time.
+ */
+static void pick_sync_slot(struct v4l2_mplane_source* s)
+{
+    uint64_t now         = os_gettime_ns();
+    uint64_t newest      = 0;
+    int      newest_slot = -1;
+    for (int i = 0; i < TEXTURE_RING_SIZE; i++) {
+        if (!s->ring_ts[i] || i == s->ring_write || i == s->ring_staged)
+            continue;
+        if (s->ring_ts[i] > newest) {
+            newest      = s->ring_ts[i];
+            newest_slot = i;
         }
-    } else {
-        blog(LOG_ERROR, "[axon] DQBUF invalid index %d", idx);
     }
+    if (newest_slot < 0)
+        return;
 
-    struct v4l2_buffer qbuf;
-    struct v4l2_plane  qplanes[VIDEO_MAX_PLANES];
-    memset(&qbuf, 0, sizeof(qbuf));
-    memset(qplanes, 0, sizeof(qplanes));
-    qbuf.type     = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    qbuf.memory   = V4L2_MEMORY_MMAP;
-    qbuf.index    = buf.index;
-    qbuf.m.planes = qplanes;
-    qbuf.length   = buf.length;
+    axon_sync_publish(s->sync, newest, now);
+    uint64_t target = axon_sync_target(s->sync, s->sync_max_latency_ns, now);
 
-    if (ioctl(s->fd, VIDIOC_QBUF, &qbuf) < 0) {
-        blog(LOG_ERROR, "[axon] QBUF after DQBUF failed: %s", strerror(errno));
+    int      best      = newest_slot;
+    uint64_t best_diff = UINT64_MAX;
+    for (int i = 0; target && i < TEXTURE_RING_SIZE; i++) {
+        uint64_t ts = s->ring_ts[i];
+        if (!ts || i == s->ring_write || i == s->ring_staged || ts < s->sync_drawn_ts)
+            continue;
+        uint64_t diff = ts > target ? ts - target : target - ts;
+        if (diff < best_diff) {
+            best      = i;
+            best_diff = diff;
+        }
     }
+    s->ring_draw     = best;
+    s->sync_drawn_ts = s->ring_ts[best];
 }
 
 static void mplane_render(void* data, gs_effect_t* effect)
 {
     struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) data;
-    if (!s || !s->texture)
+    if (!s)
         return;
+    if (!s->ring[0]) {
+        draw_placeholder(s, effect);
+        return;
+    }
+
+    /* a frame staged on the previous tick has finished uploading by now */
+    if (s->ring_staged >= 0) {
+        s->ring_draw   = s->ring_staged;
+        s->ring_staged = -1;
+    }
 
-    bool do_upload = false;
+    /* take the front buffer for upload; convert_done can swap again while it is copied */
+    bool           do_upload = false;
+    int            shift     = 0;
+    uint64_t       ts        = 0;
+    const uint8_t* pixels    = NULL;
     pthread_mutex_lock(&s->frame_lock);
     if (s->new_frame) {
-        s->new_frame = false;
-        do_upload    = true;
+        uint8_t* tmp  = s->rgb_upload;
+        s->rgb_upload = s->rgb_front;
+        s->rgb_front  = tmp;
+        s->new_frame  = false;
+        do_upload     = true;
+        shift         = s->front_shift;
+        ts            = s->front_ts;
+        pixels        = s->rgb_upload;
+    } else if (s->field_pending) {
+        /* the second bob field goes up on the tick after its frame, unless a newer one came */
+        uint8_t* tmp     = s->field_upload;
+        s->field_upload  = s->field_front;
+        s->field_front   = tmp;
+        s->field_pending = false;
+        do_upload        = true;
+        shift            = s->front_shift;
+        ts               = s->field_ts;
+        pixels           = s->field_upload;
     }
     pthread_mutex_unlock(&s->frame_lock);
 
     if (do_upload) {
-        gs_texture_set_image(s->texture, (const uint8_t*) s->rgb_front, (uint32_t) (s->width * 4),
-                             false);
+        AXON_TRACE_SCOPE("texture upload");
+        int           slot = s->ring_write;
+        gs_texture_t* tex  = ring_texture(s, slot, shift);
+        if (tex) {
+            gs_texture_set_image(tex, pixels, (uint32_t) ((output_width(s) >> shift) * 4), false);
+            s->ring_ts[slot] = ts;
+            s->ring_write    = (slot + 1) % TEXTURE_RING_SIZE;
+            if (s->staged_upload && s->ring_draw >= 0)
+                s->ring_staged = slot;
+            else
+                s->ring_draw = slot;
+        }
+
+        int64_t latency = (int64_t) (os_gettime_ns() - ts);
+        s->latency_ns_avg += (latency - (int64_t) s->latency_ns_avg) / 8;
+    }
+
+    if (s->sync)
+        pick_sync_slot(s);
+
+    if (s->ring_draw < 0) {
+        draw_placeholder(s, effect);
+        return;
     }
 
-    gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), s->texture);
-    gs_draw_sprite(s->texture, 0, s->width, s->height);
+    /* reduced-resolution frames are stretched back to the source size */
+    gs_texture_t* tex = s->ring[s->ring_draw];
+    if (!tex)
+        return;
+    gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
+    gs_draw_sprite(tex, 0, (uint32_t) output_width(s), (uint32_t) output_height(s));
 }
 
 static void mplane_get_defaults(obs_data_t* settings)
 {
     obs_data_set_default_string(settings, "device_path", "/dev/video11");
     obs_data_set_default_string(settings, "resolution", "640x480");
+    obs_data_set_default_bool(settings, "drop_late", true);
+    obs_data_set_default_bool(settings, "keep_warm", false);
+    obs_data_set_default_bool(settings, "staged_upload", true);
+    obs_data_set_default_bool(settings, "media_setup", true);
+    obs_data_set_default_bool(settings, "request_controls", false);
+    obs_data_set_default_string(settings, "sync_group", "");
+    obs_data_set_default_int(settings, "sync_max_latency_ms", 50);
+    obs_data_set_default_string(settings, "preview_quality", "full");
+    obs_data_set_default_int(settings, "rotation", 0);
+    obs_data_set_default_bool(settings, "flip_horizontal", false);
+    obs_data_set_default_bool(settings, "flip_vertical", false);
+    obs_data_set_default_string(settings, "lut_path", "");
+    obs_data_set_default_string(settings, "deinterlace", "adaptive");
+    obs_data_set_default_int(settings, "bit_depth", 8);
+    obs_data_set_default_string(settings, "bt2020_transfer", "sdr");
+    obs_data_set_default_string(settings, "m2m_device", "");
+    obs_data_set_default_string(settings, "encoder_device", "");
+    obs_data_set_default_string(settings, "overload_mode", "drop_oldest");
+    obs_data_set_default_int(settings, "overload_queue_depth", 2);
+    obs_data_set_default_int(settings, "overload_load_percent", 85);
+    obs_data_set_default_string(settings, "latency_mode", "off");
+    obs_data_set_default_int(settings, "latency_row_percent", 50);
     // obs_data_set_default_string(settings, "resolution", "1280x720");
 }
 
-static obs_properties_t* mplane_get_properties(void* unused)
+static bool trace_toggle_clicked(obs_properties_t* props, obs_property_t* p, void* data)
 {
-    (void) unused;
-    obs_properties_t* props = obs_properties_create();
+    (void) props;
+    (void) p;
+    (void) data;
+    if (axon_trace_enabled)
+        axon_trace_stop();
+    else
+        axon_trace_start();
+    return false;
+}
+
+static bool trace_save_clicked(obs_properties_t* props, obs_property_t* p, void* data)
+{
+    (void) props;
+    (void) p;
+    (void) data;
+    axon_trace_dump_default();
+    return false;
+}
+
+static void trace_toggle_hotkey(void* data, obs_hotkey_id id, obs_hotkey_t* hotkey, bool pressed)
+{
+    if (pressed)
+        trace_toggle_clicked(NULL, NULL, data);
+    (void) id;
+    (void) hotkey;
+}
+
+static void trace_save_hotkey(void* data, obs_hotkey_id id, obs_hotkey_t* hotkey, bool pressed)
+{
+    (void) data;
+    (void) id;
+    (void) hotkey;
+    if (pressed)
+        axon_trace_dump_default();
+}
+
+static obs_properties_t* mplane_get_properties(void* data)
+{
+    struct v4l2_mplane_source* s     = (struct v4l2_mplane_source*) data;
+    obs_properties_t*          props = obs_properties_create();
 
     obs_property_t* res = obs_properties_add_list(props, "resolution", "Resolution",
                                                   OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
@@ -723,6 +2655,85 @@ static obs_properties_t* mplane_get_properties(void* unused)
     obs_property_list_add_string(res, "1280x720", "1280x720");
     obs_property_list_add_string(res, "640x480", "640x480");
 
+    obs_properties_add_bool(props, "drop_late", "Drop conversions that miss the next frame");
+    obs_properties_add_bool(props, "keep_warm", "Keep the camera running while not shown");
+    obs_properties_add_bool(props, "staged_upload",
+                            "Stage texture uploads (draw lags upload by one frame)");
+
+    obs_property_t* pq =
+        obs_properties_add_list(props, "preview_quality", "Quality when not in program",
+                                OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+    obs_property_list_add_string(pq, "Full resolution", "full");
+    obs_property_list_add_string(pq, "Half resolution", "half");
+    obs_property_list_add_string(pq, "Quarter resolution", "quarter");
+
+    obs_property_t* rot = obs_properties_add_list(props, "rotation", "Rotation",
+                                                  OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+    obs_property_list_add_int(rot, "None", 0);
+    obs_property_list_add_int(rot, "90° clockwise", 90);
+    obs_property_list_add_int(rot, "180°", 180);
+    obs_property_list_add_int(rot, "90° counter-clockwise", 270);
+    obs_properties_add_bool(props, "flip_horizontal", "Mirror horizontally");
+    obs_properties_add_bool(props, "flip_vertical", "Flip vertically");
+    obs_property_t* depth = obs_properties_add_list(props, "bit_depth", "Capture bit depth",
+                                                    OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+    obs_property_list_add_int(depth, "8-bit (NV12)", 8);
+    obs_property_list_add_int(depth, "10-bit (P010/NV15) when available", 10);
+    obs_property_t* trc = obs_properties_add_list(props, "bt2020_transfer", "BT.2020 transfer",
+                                                  OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+    obs_property_list_add_string(trc, "Standard dynamic range", "sdr");
+    obs_property_list_add_string(trc, "HLG", "hlg");
+
+    obs_property_t* di = obs_properties_add_list(props, "deinterlace", "Deinterlacing",
+                                                 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+    obs_property_list_add_string(di, "Off (weave fields)", "off");
+    obs_property_list_add_string(di, "Bob (field rate)", "bob");
+    obs_property_list_add_string(di, "Linear blend", "blend");
+    obs_property_list_add_string(di, "Motion adaptive", "adaptive");
+    obs_properties_add_path(props, "lut_path", "Colour LUT (.cube)", OBS_PATH_FILE,
+                            "Cube LUT (*.cube)", NULL);
+
+    obs_properties_add_bool(props, "media_setup", "Configure sensor/ISP pipeline");
+    obs_properties_add_bool(props, "request_controls", "Apply controls per frame (Request API)");
+    obs_properties_add_text(props, "sync_group", "Sync group (empty for none)", OBS_TEXT_DEFAULT);
+    obs_property_t* sync = obs_properties_add_int_slider(props, "sync_max_latency_ms",
+                                                         "Sync maximum added latency", 0, 200, 5);
+    obs_property_int_set_suffix(sync, " ms");
+    if (s)
+        axon_controls_add_properties(&s->controls, props);
+    obs_properties_add_text(props, "m2m_device", "Hardware converter (M2M node, empty for CPU)",
+                            OBS_TEXT_DEFAULT);
+    obs_properties_add_text(props, "encoder_device",
+                            "Record-only encoder (M2M node, bypasses OBS)", OBS_TEXT_DEFAULT);
+    obs_properties_add_path(props, "encode_dir", "Recording folder", OBS_PATH_DIRECTORY, NULL,
+                            NULL);
+
+    obs_property_t* ov = obs_properties_add_list(props, "overload_mode", "When overloaded",
+                                                 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+    obs_property_list_add_string(ov, "Drop oldest waiting frames", "drop_oldest");
+    obs_property_list_add_string(ov, "Drop newest frames", "drop_newest");
+    obs_property_list_add_string(ov, "Halve resolution", "halve_resolution");
+    obs_property_list_add_string(ov, "Halve frame rate", "halve_framerate");
+    obs_properties_add_int(props, "overload_queue_depth", "Overload queue depth (frames)", 1,
+                           BUFFER_COUNT - 1, 1);
+    obs_property_t* load = obs_properties_add_int_slider(
+        props, "overload_load_percent", "Overload conversion load", 10, 100, 5);
+    obs_property_int_set_suffix(load, "%");
+
+    obs_property_t* lat = obs_properties_add_list(props, "latency_mode", "Latency measurement",
+                                                  OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+    obs_property_list_add_string(lat, "Off", "off");
+    obs_property_list_add_string(lat, "Read latency pattern from camera", "measure");
+    obs_property_list_add_string(lat, "Inject pattern (test devices)", "inject");
+    obs_property_t* row =
+        obs_properties_add_int_slider(props, "latency_row_percent", "Pattern row", 0, 100, 1);
+    obs_property_int_set_suffix(row, "%");
+
+    obs_properties_add_button(props, "trace_toggle", "Start/stop tracing (all sources)",
+                              trace_toggle_clicked);
+    obs_properties_add_button(props, "trace_save", "Save trace (Chrome/Perfetto JSON)",
+                              trace_save_clicked);
+
     obs_property_t* p = obs_properties_add_list(props, "device_path", "Video Device",
                                                 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
 
@@ -743,15 +2754,26 @@ static void mplane_destroy(void* data)
     if (!s)
         return;
 
-    s->reconfiguring = true;
+    axon_metrics_unregister(s);
+    cancel_device_tasks(s);
+
     pthread_mutex_lock(&s->io_lock);
 
     stop_device(s);
-    destroy_texture(s);
-    destroy_rgb(s);
+    release_frames(s);
 
     pthread_mutex_unlock(&s->io_lock);
 
+    if (s->placeholder) {
+        obs_enter_graphics();
+        gs_texture_destroy(s->placeholder);
+        obs_leave_graphics();
+    }
+
+    axon_sync_leave(s->sync);
+    axon_controls_free(&s->controls);
+    pthread_cond_destroy(&s->capture_cond);
+    pthread_mutex_destroy(&s->capture_lock);
     pthread_mutex_destroy(&s->io_lock);
     pthread_mutex_destroy(&s->frame_lock);
 
@@ -770,14 +2792,75 @@ static struct obs_source_info mplane_source_info = {
     .get_defaults   = mplane_get_defaults,
     .get_properties = mplane_get_properties,
     .update         = mplane_update,
-    .video_tick     = mplane_tick,
+    .show           = mplane_show,
+    .hide           = mplane_hide,
     .video_render   = mplane_render,
     .icon_type      = OBS_ICON_TYPE_CAMERA,
 };
 
+/* same capture, frames handed to libobs as they are; OBS converts on the GPU */
+static struct obs_source_info mplane_async_source_info = {
+    .id             = "v4l2_mplane_source_axon_async",
+    .type           = OBS_SOURCE_TYPE_INPUT,
+    .output_flags   = OBS_SOURCE_ASYNC_VIDEO | OBS_SOURCE_AUDIO,
+    .get_name       = mplane_async_get_name,
+    .create         = mplane_async_create,
+    .destroy        = mplane_destroy,
+    .get_width      = mplane_width,
+    .get_height     = mplane_height,
+    .get_defaults   = mplane_get_defaults,
+    .get_properties = mplane_get_properties,
+    .update         = mplane_update,
+    .show           = mplane_show,
+    .hide           = mplane_hide,
+    .icon_type      = OBS_ICON_TYPE_CAMERA,
+};
+
+bool axon_source_get_stats(obs_source_t* source, struct axon_capture_stats* stats)
+{
+    const char* id = obs_source_get_unversioned_id(source);
+    if (!id || (strcmp(id, mplane_source_info.id) && strcmp(id, mplane_async_source_info.id)))
+        return false;
+
+    struct v4l2_mplane_source* s = (struct v4l2_mplane_source*) obs_obj_get_data(source);
+    if (!s || s->fd < 0)
+        return false;
+
+    fill_stats(s, stats);
+    return true;
+}
+
 bool obs_module_load(void)
 {
+    if (!axon_loop_init())
+        return false;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (!axon_pool_init(cpus > 1 ? (int) cpus - 1 : 1)) {
+        axon_loop_shutdown();
+        return false;
+    }
+
     blog(LOG_INFO, "[v4l2 axon camera plugin]: plugin loaded successfully");
     obs_register_source(&mplane_source_info);
+    obs_register_source(&mplane_async_source_info);
+    obs_register_source(&axon_overlay_filter_info);
+    obs_register_source(&axon_latency_pattern_info);
+
+    /* optional, the plugin works without an exporter */
+    axon_metrics_init();
+
+    obs_hotkey_register_frontend("axon_trace_toggle", "Axon camera: start/stop tracing",
+                                 trace_toggle_hotkey, NULL);
+    obs_hotkey_register_frontend("axon_trace_save", "Axon camera: save trace",
+                                 trace_save_hotkey, NULL);
     return true;
 }
+
+void obs_module_unload(void)
+{
+    axon_metrics_shutdown();
+    axon_loop_shutdown();
+    axon_pool_shutdown();
+    axon_trace_shutdown();
+}
@@ -0,0 +1,771 @@
+/*
+ * Conformance and speed check of the conversion kernels, run by CTest; it
+ * needs no camera and no OBS, only a small libobs stub.
+ *
+ *   axon-selftest --conformance
+ *   axon-selftest --lut-write FILE | --lut-compare FILE
+ *   axon-selftest --speed BASELINE [--rebase]
+ *
+ * Every kernel in the dispatch table is compared with a double precision
+ * reference on random and edge-case frames (odd sizes, padded strides,
+ * extreme Y/UV values) under every shift and transform, and the maximum
+ * per-channel deviation is logged. Paths that must agree exactly are
+ * compared byte for byte: NV15 against P010, striped against whole frames,
+ * the output layouts against each other and an identity LUT against none.
+ *
+ * Graded 17^3, 33^3 and 65^3 tables with crosstalk and per-node jitter go
+ * through the LUT and are held to a double precision tetrahedral reference;
+ * a wrong tetrahedron or weight is off by far more than the tolerance. The
+ * build with the portable blend writes its output, and the SSE2/NEON build
+ * must match it byte for byte.
+ *
+ * Timings of a 1080p frame are compared with the baseline committed in
+ * tests/selftest-baseline.txt. Wall-clock numbers only hold on the machine
+ * that recorded them, so ctest runs this only with -DENABLE_SPEED_TEST=ON.
+ * After an intended speed change, or to move the baseline to the CI
+ * machine, run with --rebase and commit the file.
+ */
+
+#include "axon-convert.h"
+#include "axon-lut.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* kernel against the double precision reference, in 8-bit steps */
+#define SELFTEST_TOLERANCE 1
+
+/* a timing this much over its baseline fails */
+#define SELFTEST_SLACK_PERCENT 25
+
+/* timings are the best of this many rounds of back-to-back 1080p frames, spread out in time */
+#define SELFTEST_ROUNDS   5
+#define SELFTEST_RUNS     4
+#define SELFTEST_PAUSE_US 100000
+
+static const char* format_names[] = {"nv12", "p010", "nv15"};
+static const char* matrix_names[] = {"bt601", "bt709", "bt2020"};
+static const char* range_names[]  = {"limited", "full"};
+
+/* odd sizes, padded strides, NV15 chunk and rotation tile boundaries */
+static const struct {
+    int width, height, pad;
+} geometries[] = {
+    {1, 1, 0}, {2, 2, 8}, {3, 5, 0}, {17, 9, 24}, {64, 18, 0}, {261, 35, 40}, {1030, 20, 8},
+};
+
+/* 10-bit values around black, white and the chroma limits; NV12 uses the top 8 bits */
+static const uint16_t extremes[] = {0, 4, 60, 64, 512, 940, 960, 1016, 1023};
+
+/*
+ * One frame in every format, holding the same samples. The logical planes
+ * are 10-bit; P010 gets random junk in its unused low bits.
+ */
+struct test_frame {
+    int       width, height;
+    int       uv_width, uv_height;
+    uint16_t* y;
+    uint16_t* uv;
+    uint8_t*  planes[AXON_YUV_FORMATS][2];
+    int       strides[AXON_YUV_FORMATS][2];
+};
+
+struct selftest {
+    uint32_t seed;
+    int      deviation[AXON_YUV_FORMATS][AXON_MATRICES][AXON_RANGES][3];
+    int      mismatches;
+};
+
+/* xorshift, so a failure reproduces on every run */
+static uint32_t next_random(struct selftest* t)
+{
+    t->seed ^= t->seed << 13;
+    t->seed ^= t->seed >> 17;
+    t->seed ^= t->seed << 5;
+    return t->seed;
+}
+
+static uint8_t* pack_plane(struct selftest* t, enum axon_yuv_format fmt, const uint16_t* samples,
+                           int width, int rows, int pad, int* stride)
+{
+    if (fmt == AXON_YUV_NV12)
+        *stride = width + pad;
+    else if (fmt == AXON_YUV_P010)
+        *stride = 2 * width + pad;
+    else
+        *stride = (width + 3) / 4 * 5 + pad;
+
+    uint8_t* plane = (uint8_t*) bzalloc((size_t) *stride * rows);
+    for (int r = 0; r < rows; r++) {
+        const uint16_t* in  = samples + (size_t) r * width;
+        uint8_t*        out = plane + (size_t) r * *stride;
+
+        if (fmt == AXON_YUV_NV12) {
+            for (int i = 0; i < width; i++)
+                out[i] = (uint8_t) (in[i] >> 2);
+        } else if (fmt == AXON_YUV_P010) {
+            for (int i = 0; i < width; i++) {
+                uint16_t v = (uint16_t) (in[i] << 6 | (next_random(t) & 63));
+                memcpy(out + 2 * i, &v, sizeof(v));
+            }
+        } else {
+            for (int i = 0; i < width; i += 4) {
+                uint64_t v = 0;
+                for (int k = 0; k < 4 && i + k < width; k++)
+                    v |= (uint64_t) in[i + k] << (10 * k);
+                for (int k = 0; k < 5; k++)
+                    out[i / 4 * 5 + k] = (uint8_t) (v >> (8 * k));
+            }
+        }
+    }
+    return plane;
+}
+
+static void build_frame(struct selftest* t, struct test_frame* f, int width, int height, int pad,
+                        bool extreme)
+{
+    f->width     = width;
+    f->height    = height;
+    f->uv_width  = (width + 1) & ~1;
+    f->uv_height = (height + 1) / 2;
+    f->y         = (uint16_t*) bmalloc(sizeof(uint16_t) * width * height);
+    f->uv        = (uint16_t*) bmalloc(sizeof(uint16_t) * f->uv_width * f->uv_height);
+
+    int n = sizeof(extremes) / sizeof(extremes[0]);
+    for (int i = 0; i < width * height; i++)
+        f->y[i] = extreme ? extremes[next_random(t) % n] : (uint16_t) (next_random(t) & 1023);
+    for (int i = 0; i < f->uv_width * f->uv_height; i++)
+        f->uv[i] = extreme ? extremes[next_random(t) % n] : (uint16_t) (next_random(t) & 1023);
+
+    for (int fmt = 0; fmt < AXON_YUV_FORMATS; fmt++) {
+        f->planes[fmt][0] = pack_plane(t, (enum axon_yuv_format) fmt, f->y, width, height, pad,
+                                       &f->strides[fmt][0]);
+        f->planes[fmt][1] = pack_plane(t, (enum axon_yuv_format) fmt, f->uv, f->uv_width,
+                                       f->uv_height, pad, &f->strides[fmt][1]);
+    }
+}
+
+static void free_frame(struct test_frame* f)
+{
+    for (int fmt = 0; fmt < AXON_YUV_FORMATS; fmt++) {
+        bfree(f->planes[fmt][0]);
+        bfree(f->planes[fmt][1]);
+    }
+    bfree(f->y);
+    bfree(f->uv);
+}
+
+static int reference_channel(double v)
+{
+    v = floor(v * 255.0 + 0.5);
+    return v < 0.0 ? 0 : (v > 255.0 ? 255 : (int) v);
+}
+
+/*
+ * What the kernels are meant to produce, BGR per pixel at this shift. The
+ * block averages truncate like the kernels do; everything after that is
+ * done in doubles straight from Kr/Kb.
+ */
+static void reference_frame(const struct test_frame* f, enum axon_yuv_format fmt,
+                            enum axon_matrix m, enum axon_range r, int shift, uint8_t* bgr)
+{
+    static const double kr_of[] = {0.299, 0.2126, 0.2627};
+    static const double kb_of[] = {0.114, 0.0722, 0.0593};
+
+    double kr    = kr_of[m];
+    double kb    = kb_of[m];
+    int    drop  = fmt == AXON_YUV_NV12 ? 2 : 0;
+    double scale = fmt == AXON_YUV_NV12 ? 1.0 : 4.0;
+    int    block = 1 << shift;
+    int    cb    = shift ? block / 2 : 1;
+    int    w     = f->width >> shift;
+    int    h     = f->height >> shift;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int ysum = 0, usum = 0, vsum = 0;
+            for (int dy = 0; dy < block; dy++)
+                for (int dx = 0; dx < block; dx++)
+                    ysum += f->y[(size_t) (y * block + dy) * f->width + x * block + dx] >> drop;
+
+            int c_row  = shift ? y * cb : y / 2;
+            int c_pair = shift ? x * cb : x / 2;
+            for (int dy = 0; dy < cb; dy++) {
+                for (int dx = 0; dx < cb; dx++) {
+                    const uint16_t* p =
+                        f->uv + (size_t) (c_row + dy) * f->uv_width + 2 * (c_pair + dx);
+                    usum += p[0] >> drop;
+                    vsum += p[1] >> drop;
+                }
+            }
+
+            int    c_shift = shift ? 2 * (shift - 1) : 0;
+            double yv      = (ysum >> (2 * shift)) / scale;
+            double uv      = (usum >> c_shift) / scale - 128.0;
+            double vv      = (vsum >> c_shift) / scale - 128.0;
+            double yn      = r == AXON_RANGE_FULL ? yv / 255.0 : (yv - 16.0) / 219.0;
+            double un      = uv / (r == AXON_RANGE_FULL ? 255.0 : 224.0);
+            double vn      = vv / (r == AXON_RANGE_FULL ? 255.0 : 224.0);
+
+            double red   = yn + 2.0 * (1.0 - kr) * vn;
+            double blue  = yn + 2.0 * (1.0 - kb) * un;
+            double green = (yn - kr * red - kb * blue) / (1.0 - kr - kb);
+
+            uint8_t* out = bgr + 3 * ((size_t) y * w + x);
+            out[0]       = (uint8_t) reference_channel(blue);
+            out[1]       = (uint8_t) reference_channel(green);
+            out[2]       = (uint8_t) reference_channel(red);
+        }
+    }
+}
+
+/* source pixel shown at output (i, j), for a w x h source */
+static void source_of(const struct axon_transform* xf, int w, int h, int i, int j, int* x, int* y)
+{
+    bool swap = axon_transform_swaps_axes(xf);
+    int  ow   = swap ? h : w;
+    int  oh   = swap ? w : h;
+    int  ii   = xf->hflip ? ow - 1 - i : i;
+    int  jj   = xf->vflip ? oh - 1 - j : j;
+
+    switch (xf->rotation & 3) {
+    case 0:
+        *x = ii, *y = jj;
+        break;
+    case 1:
+        *x = jj, *y = h - 1 - ii;
+        break;
+    case 2:
+        *x = w - 1 - ii, *y = h - 1 - jj;
+        break;
+    default:
+        *x = w - 1 - jj, *y = ii;
+        break;
+    }
+}
+
+static void convert(const struct test_frame* f, struct axon_convert_format cf, uint8_t* out,
+                    int shift, const struct axon_transform* xf, const struct axon_lut* lut,
+                    int band)
+{
+    int h = f->height >> shift;
+    for (int row = 0; row < h; row += band) {
+        axon_convert_rows(&cf, out, f->planes[cf.yuv][0], f->planes[cf.yuv][1],
+                          f->width >> shift, h, f->strides[cf.yuv][0], f->strides[cf.yuv][1],
+                          shift, xf, lut, row, row + band < h ? row + band : h);
+    }
+}
+
+static void mismatch(struct selftest* t, const char* what, struct axon_convert_format cf,
+                     int shift, const struct axon_transform* xf, const struct test_frame* f)
+{
+    if (t->mismatches++ < 8) {
+        blog(LOG_ERROR, "[axon] Self-test: %s differs for %s %s %s, %dx%d shift %d rotation %d%s%s",
+             what, format_names[cf.yuv], matrix_names[cf.matrix], range_names[cf.range],
+             f->width, f->height, shift, xf->rotation, xf->hflip ? " hflip" : "",
+             xf->vflip ? " vflip" : "");
+    }
+}
+
+/* one frame, one format/matrix/range, every shift and transform */
+static void check_combination(struct selftest* t, const struct test_frame* f,
+                              struct axon_convert_format cf, const struct axon_lut* lut,
+                              uint8_t* bgr, uint8_t* out, uint8_t* other)
+{
+    int* dev = t->deviation[cf.yuv][cf.matrix][cf.range];
+
+    for (int shift = 0; shift <= 2; shift++) {
+        int w = f->width >> shift;
+        int h = f->height >> shift;
+        if (!w || !h)
+            continue;
+
+        size_t size = (size_t) w * h * 4;
+        reference_frame(f, cf.yuv, cf.matrix, cf.range, shift, bgr);
+
+        for (int k = 0; k < 16; k++) {
+            struct axon_transform xf = {k >> 2, (k & 1) != 0, (k & 2) != 0};
+            int                   ow = axon_transform_swaps_axes(&xf) ? h : w;
+            int                   oh = axon_transform_swaps_axes(&xf) ? w : h;
+
+            cf.layout = AXON_RGB_BGRA;
+            convert(f, cf, out, shift, &xf, NULL, h);
+            for (int j = 0; j < oh; j++) {
+                for (int i = 0; i < ow; i++) {
+                    int x, y;
+                    source_of(&xf, w, h, i, j, &x, &y);
+                    const uint8_t* got  = out + 4 * ((size_t) j * ow + i);
+                    const uint8_t* want = bgr + 3 * ((size_t) y * w + x);
+                    for (int c = 0; c < 3; c++) {
+                        int d  = abs(got[c] - want[c]);
+                        dev[c] = d > dev[c] ? d : dev[c];
+                    }
+                    if (got[3] != 255)
+                        dev[0] = dev[1] = dev[2] = 255;
+                }
+            }
+
+            convert(f, cf, other, shift, &xf, NULL, 2);
+            if (memcmp(out, other, size))
+                mismatch(t, "striped conversion", cf, shift, &xf, f);
+
+            cf.layout = AXON_RGB_RGBA;
+            convert(f, cf, other, shift, &xf, NULL, h);
+            for (size_t p = 0; p < size; p += 4) {
+                if (other[p] != out[p + 2] || other[p + 1] != out[p + 1] ||
+                    other[p + 2] != out[p] || other[p + 3] != 255) {
+                    mismatch(t, "RGBA layout", cf, shift, &xf, f);
+                    break;
+                }
+            }
+
+            cf.layout = AXON_RGB_BGRX;
+            convert(f, cf, other, shift, &xf, NULL, h);
+            for (size_t p = 0; p < size; p += 4) {
+                if (memcmp(other + p, out + p, 3)) {
+                    mismatch(t, "BGRX layout", cf, shift, &xf, f);
+                    break;
+                }
+            }
+
+            if (cf.yuv == AXON_YUV_NV15) {
+                struct axon_convert_format p010 = cf;
+                p010.yuv                        = AXON_YUV_P010;
+                p010.layout                     = AXON_RGB_BGRA;
+                convert(f, p010, other, shift, &xf, NULL, h);
+                if (memcmp(out, other, size))
+                    mismatch(t, "NV15 against P010", cf, shift, &xf, f);
+            }
+
+            if (lut && cf.yuv == AXON_YUV_NV12) {
+                cf.layout = AXON_RGB_BGRA;
+                convert(f, cf, other, shift, &xf, lut, h);
+                if (memcmp(out, other, size))
+                    mismatch(t, "identity LUT", cf, shift, &xf, f);
+            }
+        }
+    }
+}
+
+/* size^3 nodes, r g b each, red fastest, written out as a .cube and loaded */
+static struct axon_lut* load_table(int size, const double* nodes)
+{
+    char path[] = "/tmp/axon-selftest-XXXXXX";
+    int  fd     = mkstemp(path);
+    if (fd < 0)
+        return NULL;
+
+    FILE* f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        unlink(path);
+        return NULL;
+    }
+    fprintf(f, "LUT_3D_SIZE %d\n", size);
+    for (int i = 0; i < size * size * size; i++)
+        fprintf(f, "%.9f %.9f %.9f\n", nodes[3 * i], nodes[3 * i + 1], nodes[3 * i + 2]);
+    fclose(f);
+
+    struct axon_lut* lut = axon_lut_acquire(path);
+    unlink(path);
+    return lut;
+}
+
+/* a 17^3 identity table, which tetrahedral interpolation must reproduce exactly */
+static struct axon_lut* identity_lut(void)
+{
+    double* nodes = (double*) bmalloc(sizeof(double) * 3 * 17 * 17 * 17);
+    for (int b = 0, i = 0; b < 17; b++) {
+        for (int g = 0; g < 17; g++) {
+            for (int r = 0; r < 17; r++, i += 3) {
+                nodes[i]     = r / 16.0;
+                nodes[i + 1] = g / 16.0;
+                nodes[i + 2] = b / 16.0;
+            }
+        }
+    }
+    struct axon_lut* lut = load_table(17, nodes);
+    bfree(nodes);
+    return lut;
+}
+
+static bool check_kernels(void)
+{
+    struct selftest  t;
+    struct axon_lut* lut = identity_lut();
+    size_t           max = 0;
+
+    memset(&t, 0, sizeof(t));
+    t.seed = 0x2545f491;
+    if (!lut)
+        blog(LOG_WARNING, "[axon] Self-test: cannot write a LUT, skipping the LUT check");
+
+    for (size_t g = 0; g < sizeof(geometries) / sizeof(geometries[0]); g++) {
+        size_t size = (size_t) geometries[g].width * geometries[g].height;
+        max         = size > max ? size : max;
+    }
+    uint8_t* bgr   = (uint8_t*) bmalloc(max * 3);
+    uint8_t* out   = (uint8_t*) bmalloc(max * 4);
+    uint8_t* other = (uint8_t*) bmalloc(max * 4);
+
+    for (size_t g = 0; g < sizeof(geometries) / sizeof(geometries[0]); g++) {
+        for (int extreme = 0; extreme < 2; extreme++) {
+            struct test_frame f;
+            build_frame(&t, &f, geometries[g].width, geometries[g].height, geometries[g].pad,
+                        extreme != 0);
+
+            for (int fmt = 0; fmt < AXON_YUV_FORMATS; fmt++) {
+                for (int m = 0; m < AXON_MATRICES; m++) {
+                    for (int r = 0; r < AXON_RANGES; r++) {
+                        struct axon_convert_format cf = {
+                            (enum axon_yuv_format) fmt, (enum axon_matrix) m,
+                            (enum axon_range) r, AXON_RGB_BGRA};
+                        check_combination(&t, &f, cf, lut, bgr, out, other);
+                    }
+                }
+            }
+            free_frame(&f);
+        }
+    }
+
+    bfree(bgr);
+    bfree(out);
+    bfree(other);
+    axon_lut_release(lut);
+
+    bool ok = t.mismatches == 0;
+    for (int fmt = 0; fmt < AXON_YUV_FORMATS; fmt++) {
+        for (int m = 0; m < AXON_MATRICES; m++) {
+            for (int r = 0; r < AXON_RANGES; r++) {
+                const int* dev  = t.deviation[fmt][m][r];
+                bool       good = dev[0] <= SELFTEST_TOLERANCE && dev[1] <= SELFTEST_TOLERANCE &&
+                            dev[2] <= SELFTEST_TOLERANCE;
+                blog(good ? LOG_INFO : LOG_ERROR,
+                     "[axon] Self-test %s %s %s: max deviation r %d g %d b %d", format_names[fmt],
+                     matrix_names[m], range_names[r], dev[2], dev[1], dev[0]);
+                ok = ok && good;
+            }
+        }
+    }
+    if (t.mismatches)
+        blog(LOG_ERROR, "[axon] Self-test: %d exact comparisons failed", t.mismatches);
+    return ok;
+}
+
+static const int lut_sizes[] = {17, 33, 65};
+
+/* pixels graded through each test table, with a few greys and the cube corners first */
+#define LUT_PIXELS (1 << 18)
+
+/*
+ * A contrast curve with crosstalk between the channels, plus up to +-0.1 of
+ * jitter per node so neighbouring tetrahedra differ by tens of steps. The
+ * slope stays low enough that the kernel's 1/256 weights keep within the
+ * tolerance of the exact interpolation.
+ */
+static double* graded_table(struct selftest* t, int size)
+{
+    double* nodes = (double*) bmalloc(sizeof(double) * 3 * size * size * size);
+    double  last  = size - 1;
+
+    for (int b = 0, i = 0; b < size; b++) {
+        for (int g = 0; g < size; g++) {
+            for (int r = 0; r < size; r++, i += 3) {
+                double rv = r / last, gv = g / last, bv = b / last;
+                double v[3] = {
+                    0.8 * rv + 0.15 * gv * bv + 0.05 * sin(6.0 * bv),
+                    0.2 + 0.7 * gv * gv + 0.1 * rv,
+                    0.9 * bv - 0.2 * rv * gv + 0.2,
+                };
+                for (int c = 0; c < 3; c++) {
+                    double jitter = ((next_random(t) & 1023) / 1023.0 - 0.5) * 0.2;
+                    double n      = v[c] + jitter;
+                    nodes[i + c]  = n < 0.0 ? 0.0 : (n > 1.0 ? 1.0 : n);
+                }
+            }
+        }
+    }
+    return nodes;
+}
+
+/* the textbook tetrahedral interpolation of one BGRA pixel, in doubles */
+static void reference_lut(int size, const double* nodes, const uint8_t* in, uint8_t* out)
+{
+    const int step[3] = {1, size, size * size};
+    double    w[3];
+    int       base = 0;
+    int       order[3];
+
+    for (int c = 0; c < 3; c++) {
+        double pos  = in[2 - c] / 255.0 * (size - 1);
+        int    cell = (int) pos < size - 2 ? (int) pos : size - 2;
+        w[c]        = pos - cell;
+        base += cell * step[c];
+        order[c] = c;
+    }
+
+    /* walk c000 -> c111 along the axis with the largest weight first */
+    for (int i = 0; i < 2; i++) {
+        for (int j = i + 1; j < 3; j++) {
+            if (w[order[j]] > w[order[i]]) {
+                int tmp  = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+            }
+        }
+    }
+    int    corner[4] = {base, base + step[order[0]], base + step[order[0]] + step[order[1]],
+                        base + step[0] + step[1] + step[2]};
+    double k[4]      = {1.0 - w[order[0]], w[order[0]] - w[order[1]], w[order[1]] - w[order[2]],
+                        w[order[2]]};
+
+    for (int c = 0; c < 3; c++) {
+        double v = 0.0;
+        for (int i = 0; i < 4; i++)
+            v += k[i] * nodes[3 * corner[i] + c];
+        out[2 - c] = (uint8_t) reference_channel(v);
+    }
+    out[3] = in[3];
+}
+
+/*
+ * Grades the same pixels through every test table into graded (LUT_PIXELS
+ * BGRA pixels per table) and checks them against the reference.
+ */
+static bool check_luts(uint8_t* graded)
+{
+    struct selftest t;
+    bool            ok = true;
+    memset(&t, 0, sizeof(t));
+    t.seed = 0x6c078965;
+
+    uint8_t* pixels = (uint8_t*) bmalloc((size_t) LUT_PIXELS * 4);
+    for (int i = 0; i < LUT_PIXELS; i++) {
+        uint32_t v = next_random(&t);
+        if (i < 256)
+            v = (v & 0xff000000u) | (uint32_t) i * 0x010101u;
+        else if (i < 264)
+            v = (v & 0xff000000u) | ((i & 1) ? 0xff : 0) | ((i & 2) ? 0xff00 : 0) |
+                ((i & 4) ? 0xff0000 : 0);
+        memcpy(pixels + 4 * (size_t) i, &v, 4);
+    }
+
+    for (size_t l = 0; l < sizeof(lut_sizes) / sizeof(lut_sizes[0]); l++) {
+        int              size  = lut_sizes[l];
+        double*          nodes = graded_table(&t, size);
+        struct axon_lut* lut   = load_table(size, nodes);
+        uint8_t*         out   = graded + l * (size_t) LUT_PIXELS * 4;
+        if (!lut) {
+            blog(LOG_ERROR, "[axon] Self-test: cannot load the %d^3 test LUT", size);
+            bfree(nodes);
+            ok = false;
+            continue;
+        }
+
+        memcpy(out, pixels, (size_t) LUT_PIXELS * 4);
+        axon_lut_apply(lut, out, LUT_PIXELS);
+
+        int dev[3] = {0, 0, 0};
+        for (int i = 0; i < LUT_PIXELS; i++) {
+            uint8_t        want[4];
+            const uint8_t* got = out + 4 * (size_t) i;
+            reference_lut(size, nodes, pixels + 4 * (size_t) i, want);
+            for (int c = 0; c < 3; c++) {
+                int d  = abs(got[c] - want[c]);
+                dev[c] = d > dev[c] ? d : dev[c];
+            }
+            if (got[3] != want[3])
+                dev[0] = dev[1] = dev[2] = 255;
+        }
+        bool good = dev[0] <= SELFTEST_TOLERANCE && dev[1] <= SELFTEST_TOLERANCE &&
+                    dev[2] <= SELFTEST_TOLERANCE;
+        blog(good ? LOG_INFO : LOG_ERROR, "[axon] Self-test %d^3 LUT: max deviation r %d g %d b %d",
+             size, dev[2], dev[1], dev[0]);
+        ok = ok && good;
+
+        axon_lut_release(lut);
+        bfree(nodes);
+    }
+    bfree(pixels);
+    return ok;
+}
+
+/* the portable build writes its graded pixels, the SIMD build must match them exactly */
+static bool check_lut_output(const char* path, bool write)
+{
+    size_t   size   = sizeof(lut_sizes) / sizeof(lut_sizes[0]) * (size_t) LUT_PIXELS * 4;
+    uint8_t* graded = (uint8_t*) bzalloc(size);
+    uint8_t* stored = write ? NULL : (uint8_t*) bzalloc(size);
+    bool     ok     = check_luts(graded);
+
+    FILE* f = fopen(path, write ? "wb" : "rb");
+    if (!f) {
+        blog(LOG_ERROR, "[axon] Self-test: cannot open %s", path);
+        ok = false;
+    } else if (write) {
+        ok = fwrite(graded, 1, size, f) == size && ok;
+        ok = fclose(f) == 0 && ok;
+    } else {
+        bool same = fread(stored, 1, size, f) == size && !memcmp(stored, graded, size);
+        fclose(f);
+        blog(same ? LOG_INFO : LOG_ERROR, "[axon] Self-test: LUT output %s the portable blend",
+             same ? "matches" : "differs from");
+        ok = ok && same;
+    }
+    bfree(graded);
+    bfree(stored);
+    return ok;
+}
+
+struct timing {
+    const char* name;
+    uint64_t    ns;
+    uint64_t    baseline;
+};
+
+static uint64_t time_conversion(const struct test_frame* f, enum axon_yuv_format fmt, int shift,
+                                int rotation, const struct axon_lut* lut, uint8_t* out)
+{
+    struct axon_convert_format cf   = {fmt, AXON_MATRIX_BT601, AXON_RANGE_LIMITED, AXON_RGB_BGRA};
+    struct axon_transform      xf   = {rotation, false, false};
+    uint64_t                   best = UINT64_MAX;
+
+    for (int run = 0; run < SELFTEST_RUNS; run++) {
+        uint64_t start = os_gettime_ns();
+        convert(f, cf, out, shift, &xf, lut, f->height >> shift);
+        uint64_t ns = os_gettime_ns() - start;
+        best        = ns < best ? ns : best;
+    }
+    return best;
+}
+
+static void read_baseline(const char* path, struct timing* timings, int count)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        return;
+
+    char               name[64];
+    unsigned long long ns;
+    while (fscanf(f, "%63s %llu", name, &ns) == 2) {
+        for (int i = 0; i < count; i++) {
+            if (!strcmp(name, timings[i].name))
+                timings[i].baseline = ns;
+        }
+    }
+    fclose(f);
+}
+
+static bool write_baseline(const char* path, const struct timing* timings, int count)
+{
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        blog(LOG_ERROR, "[axon] Self-test: cannot write the baseline %s", path);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (timings[i].ns)
+            fprintf(f, "%s %llu\n", timings[i].name, (unsigned long long) timings[i].ns);
+    }
+    fclose(f);
+    blog(LOG_INFO, "[axon] Self-test: stored the baseline in %s", path);
+    return true;
+}
+
+/* single threaded, so the numbers do not depend on the machine's core count */
+static bool check_timings(const char* path, bool rebase)
+{
+    struct selftest   t;
+    struct test_frame f;
+    struct axon_lut*  lut = identity_lut();
+    uint8_t*          out = (uint8_t*) bmalloc((size_t) 1920 * 1080 * 4);
+
+    memset(&t, 0, sizeof(t));
+    t.seed = 0x9e3779b9;
+    build_frame(&t, &f, 1920, 1080, 0, false);
+
+    struct timing timings[] = {
+        {"nv12", 0, 0},     {"nv12-half", 0, 0}, {"nv12-rot90", 0, 0},
+        {"nv12-lut", 0, 0}, {"p010", 0, 0},      {"nv15", 0, 0},
+    };
+    int count = (int) (sizeof(timings) / sizeof(timings[0]));
+
+    /* a burst of load on the machine then spoils one round rather than the result */
+    for (int round = 0; round < SELFTEST_ROUNDS; round++) {
+        if (round)
+            usleep(SELFTEST_PAUSE_US);
+        uint64_t ns[] = {
+            time_conversion(&f, AXON_YUV_NV12, 0, 0, NULL, out),
+            time_conversion(&f, AXON_YUV_NV12, 1, 0, NULL, out),
+            time_conversion(&f, AXON_YUV_NV12, 0, 1, NULL, out),
+            lut ? time_conversion(&f, AXON_YUV_NV12, 0, 0, lut, out) : 0,
+            time_conversion(&f, AXON_YUV_P010, 0, 0, NULL, out),
+            time_conversion(&f, AXON_YUV_NV15, 0, 0, NULL, out),
+        };
+        for (int i = 0; i < count; i++) {
+            if (ns[i] && (!timings[i].ns || ns[i] < timings[i].ns))
+                timings[i].ns = ns[i];
+        }
+    }
+
+    free_frame(&f);
+    bfree(out);
+    axon_lut_release(lut);
+
+    if (rebase) {
+        for (int i = 0; i < count; i++)
+            blog(LOG_INFO, "[axon] Self-test %s: %.2f ms", timings[i].name, timings[i].ns / 1e6);
+        return write_baseline(path, timings, count);
+    }
+    read_baseline(path, timings, count);
+
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        if (!timings[i].ns)
+            continue;
+        if (!timings[i].baseline) {
+            blog(LOG_ERROR, "[axon] Self-test %s: %.2f ms, no baseline in %s (run --rebase)",
+                 timings[i].name, timings[i].ns / 1e6, path);
+            ok = false;
+            continue;
+        }
+
+        bool slow = timings[i].ns * 100 > timings[i].baseline * (100 + SELFTEST_SLACK_PERCENT);
+        blog(slow ? LOG_ERROR : LOG_INFO, "[axon] Self-test %s: %.2f ms, baseline %.2f ms%s",
+             timings[i].name, timings[i].ns / 1e6, timings[i].baseline / 1e6,
+             slow ? ", too slow" : "");
+        ok = ok && !slow;
+    }
+    return ok;
+}
+
+static int usage(void)
+{
+    fprintf(stderr, "usage: axon-selftest --conformance\n"
+                    "       axon-selftest --lut-write FILE | --lut-compare FILE\n"
+                    "       axon-selftest --speed BASELINE [--rebase]\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    bool ok;
+    if (argc == 2 && !strcmp(argv[1], "--conformance"))
+        ok = check_kernels();
+    else if (argc == 3 && !strcmp(argv[1], "--lut-write"))
+        ok = check_lut_output(argv[2], true);
+    else if (argc == 3 && !strcmp(argv[1], "--lut-compare"))
+        ok = check_lut_output(argv[2], false);
+    else if ((argc == 3 || argc == 4) && !strcmp(argv[1], "--speed"))
+        ok = check_timings(argv[2], argc == 4 && !strcmp(argv[3], "--rebase"));
+    else
+        return usage();
+
+    blog(ok ? LOG_INFO : LOG_ERROR, "[axon] Self-test %s", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
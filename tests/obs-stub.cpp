@@ -0,0 +1,44 @@
+#include <obs-module.h>
+#include <util/platform.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void blog(int log_level, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(log_level <= LOG_WARNING ? stderr : stdout, format, args);
+    va_end(args);
+    fputc('\n', log_level <= LOG_WARNING ? stderr : stdout);
+}
+
+void* bmalloc(size_t size)
+{
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr)
+        abort();
+    return ptr;
+}
+
+void* bzalloc(size_t size)
+{
+    void* ptr = calloc(1, size ? size : 1);
+    if (!ptr)
+        abort();
+    return ptr;
+}
+
+void bfree(void* ptr)
+{
+    free(ptr);
+}
+
+uint64_t os_gettime_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
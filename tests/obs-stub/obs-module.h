@@ -0,0 +1,24 @@
+#pragma once
+
+/*
+ * Just enough of libobs for the kernels and the LUT loader to build into
+ * the self-test without OBS installed; see obs-stub.cpp.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+enum {
+    LOG_ERROR   = 100,
+    LOG_WARNING = 200,
+    LOG_INFO    = 300,
+    LOG_DEBUG   = 400,
+};
+
+extern "C" {
+void  blog(int log_level, const char* format, ...);
+void* bmalloc(size_t size);
+void* bzalloc(size_t size);
+void  bfree(void* ptr);
+}